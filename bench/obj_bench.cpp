@@ -0,0 +1,119 @@
+#include "render/obj_loader.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Import times of generated OBJ files from 10k to 2M faces, or of the files given as arguments.
+// ns/face has to stay about the same across sizes, a growing value means import is no longer linear in the face count.
+namespace
+{
+	// a bumpy grid of quads, shared vertices with positions, texture coordinates and normals like exported models
+	std::string generate_obj(size_t faces)
+	{
+		size_t quads = std::max<size_t>(faces / 2, 1);
+		size_t side = 1;
+		while(side * side < quads)
+			side++;
+
+		std::string obj;
+		obj.reserve(faces * 80);
+		char line[128];
+		for(size_t y=0; y<=side; y++)
+		{
+			for(size_t x=0; x<=side; x++)
+			{
+				float u = float(x) / side, v = float(y) / side;
+				std::snprintf(line, sizeof(line), "v %f %f %f\nvt %f %f\nvn 0 0 1\n", u, v, 0.01f * ((x * 7 + y * 13) % 17), u, v);
+				obj += line;
+			}
+		}
+		size_t written = 0;
+		for(size_t y=0; y<side && written<faces; y++)
+		{
+			for(size_t x=0; x<side && written<faces; x++)
+			{
+				size_t a = y*(side+1) + x + 1, b = a + 1, c = a + side + 1, d = c + 1;
+				std::snprintf(line, sizeof(line), "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", a, a, a, b, b, b, d, d, d);
+				obj += line;
+				std::snprintf(line, sizeof(line), "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", a, a, a, d, d, d, c, c, c);
+				obj += line;
+				written += 2;
+			}
+		}
+		return obj;
+	}
+
+	// best of a few runs, the first one also pays for page faults of the output
+	template<class F>
+	double measure(F&& f, int runs = 3)
+	{
+		double best = 1e300;
+		for(int i=0; i<runs; i++)
+		{
+			auto t0 = std::chrono::steady_clock::now();
+			f();
+			best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+		}
+		return best;
+	}
+
+	void run(const std::string& name, const std::string& obj)
+	{
+		unsigned int threads = std::max(std::thread::hardware_concurrency(), 1u);
+		std::vector<render::vertex_data> vertices;
+		std::vector<uint32_t> indices;
+
+		double single = measure([&]{
+			vertices.clear();
+			indices.clear();
+			render::load_obj(obj, vertices, indices, 1);
+		});
+		size_t faces = indices.size() / 3;
+		double parallel = measure([&]{
+			vertices.clear();
+			indices.clear();
+			render::load_obj(obj, vertices, indices, threads);
+		});
+		double stream = measure([&]{
+			render::obj_stream s(obj);
+			s.emit([](std::span<const render::vertex_data>, std::span<const uint32_t>){});
+		});
+
+		auto nsPerFace = [faces](double t){ return faces ? t * 1e9 / faces : 0.0; };
+		std::printf("%-24s %10zu %10zu %10.2f %8.1f %10.2f %8.1f %10.2f %8.1f\n", name.c_str(), faces, vertices.size(),
+			single * 1e3, nsPerFace(single), parallel * 1e3, nsPerFace(parallel), stream * 1e3, nsPerFace(stream));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::printf("%-24s %10s %10s %10s %8s %10s %8s %10s %8s\n", "input", "faces", "vertices",
+		"1 thread", "ns/face", "threads", "ns/face", "stream", "ns/face");
+
+	if(argc > 1)
+	{
+		for(int i=1; i<argc; i++)
+		{
+			std::ifstream in(argv[i], std::ios::binary);
+			if(!in)
+			{
+				std::fprintf(stderr, "cannot open %s\n", argv[i]);
+				return EXIT_FAILURE;
+			}
+			std::string obj((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+			run(argv[i], obj);
+		}
+		return EXIT_SUCCESS;
+	}
+
+	for(size_t faces : {10'000ul, 50'000ul, 100'000ul, 500'000ul, 1'000'000ul, 2'000'000ul})
+		run("generated " + std::to_string(faces), generate_obj(faces));
+	return EXIT_SUCCESS;
+}
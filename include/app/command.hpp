@@ -2,6 +2,7 @@
 
 #include "render/model.hpp"
 #include "render/texture.hpp"
+#include "render/residency.hpp"
 
 #define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
 #include <vulkan/vulkan.hpp>
@@ -27,6 +28,12 @@ namespace app
 		bool valid = true;
 		bool fake = false;
 		std::vector<resource*> childs = {};
+		uint32_t generation = 0; // of the resident model the childs were taken from
+
+		// Marks a model as used by this frame, nullptr while it is not loaded (again)
+		render::model* use_model(render::upload_waits& waits);
+		// Points the childs of a model at its current buffers, they are invalid while it is evicted
+		void refresh();
 
 		void destroy(vk::Device device)
 		{
@@ -39,7 +46,8 @@ namespace app
 					device.destroyPipeline(std::any_cast<vk::Pipeline>(handle));
 					break;
 				case Model:
-					std::any_cast<std::shared_ptr<render::model>>(handle).reset();
+					// the residency manager frees it once no frame in flight uses it anymore
+					handle.reset();
 					break;
 				case Buffer:
 					//TODO: destroy
@@ -48,10 +56,12 @@ namespace app
 		}
 	};
 	static resource INVALID_PIPELINE{resource::Pipeline, "invalid", vk::Pipeline{}, false};
+	static resource INVALID_MODEL{resource::Model, "invalid", render::resident<render::model>{}, false};
 
 	struct command_context
 	{
 		std::vector<resource*>& resources;
+		render::upload_waits* waits = nullptr; // only while recording
 	};
 
 	struct command_state
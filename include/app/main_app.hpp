@@ -19,8 +19,10 @@ namespace app
 			void render_imgui();
 			void window_commands();
 			void window_resources();
+			void window_loader();
 
 			bool popup_pipeline();
+			render::async_task<> import_model(std::string path, std::string name);
 
 			std::vector<command> commands;
 			std::vector<resource*> resources;
@@ -4,6 +4,7 @@
 #include <vulkan/vulkan.hpp>
 
 #include <chrono>
+#include <filesystem>
 
 namespace config
 {
@@ -15,6 +16,18 @@ namespace config
 
 			int maxFPS = 100;
 			std::chrono::duration<double> frameTime = std::chrono::duration<double>(std::chrono::seconds(1))/maxFPS;
+
+			unsigned int loaderDecodeThreads = 0; // 0: one per hardware thread
+			unsigned int loaderStagingSlots = 3; // staging buffers per loader thread, decoding overlaps the transfers of the others
+			unsigned int loaderBatchSize = 32; // most tasks sharing one submission
+			std::chrono::milliseconds loaderBatchLatency = std::chrono::milliseconds(4); // longest a loaded task waits for others to join its submission
+			std::filesystem::path meshCacheDirectory = ""; // empty: store .vkmesh files next to the source files
+			// transcode PNG textures to BC1/BC3 once and load the cached .ktx2 from then on. Lossy: 4 to 8 times less memory
+			// and faster loads, but blocky gradients and color bleeding, so only worth it for textures that can take that
+			bool compressTextures = false;
+			std::filesystem::path textureCacheDirectory = ""; // empty: store .ktx2 files next to the source files
+			vk::DeviceSize residencyBudget = 0; // bytes textures and models may use before the least recently used are evicted, 0: see below
+			double residencyBudgetShare = 0.9; // of the device local memory budget reported by the driver the whole process may use
 	};
 	inline class config CONFIG;
 }
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "render/resource_loader.hpp"
+
+namespace render
+{
+	class executor
+	{
+		public:
+			virtual ~executor() = default;
+			virtual void post(std::function<void()> work) = 0;
+	};
+
+	// Collects work from any thread and runs it whenever its owner calls run(), the window does so between frames
+	class frame_executor : public executor
+	{
+		public:
+			void post(std::function<void()> work) override;
+			// Runs everything posted so far, work posted while running waits for the next call
+			void run();
+		private:
+			std::mutex lock;
+			std::vector<std::function<void()>> queue;
+	};
+
+	template<class T>
+	struct async_result
+	{
+		std::variant<std::monostate, T, std::exception_ptr> result;
+
+		void return_value(T value) { result.template emplace<1>(std::move(value)); }
+		void unhandled_exception() { result.template emplace<2>(std::current_exception()); }
+		T get()
+		{
+			if(result.index() == 2)
+				std::rethrow_exception(std::get<2>(result));
+			return std::move(std::get<1>(result));
+		}
+	};
+	template<>
+	struct async_result<void>
+	{
+		std::exception_ptr error;
+
+		void return_void() {}
+		void unhandled_exception() { error = std::current_exception(); }
+		void get()
+		{
+			if(error)
+				std::rethrow_exception(error);
+		}
+	};
+
+	// Logs the exception a spawned coroutine ended with, nobody else would see it
+	void report_detached(std::exception_ptr error);
+
+	// Switches the awaiting coroutine over to another executor
+	struct resume_on
+	{
+		executor& target;
+	};
+
+	// A lazily started coroutine that always continues on its executor. Awaiting a load never blocks a thread,
+	// the coroutine is posted to its executor once the loader is done with the task.
+	// Awaited coroutines run on the executor of the one awaiting them, top level ones are started with spawn().
+	template<class T = void>
+	class async_task
+	{
+		public:
+			struct promise_type;
+			using handle = std::coroutine_handle<promise_type>;
+
+			// wait for a load and post the coroutine back to its executor, the loader might complete the task
+			// on another thread before await_suspend returns, so it must not touch the awaiter after registering
+			struct load_awaiter
+			{
+				LoadFuture future;
+				executor* exec;
+
+				bool await_ready() const { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+				void await_suspend(std::coroutine_handle<> h)
+				{
+					future.then([exec = exec, h]{ exec->post([h]{ h.resume(); }); });
+				}
+				void await_resume() { future.get(); }
+			};
+
+			template<class R>
+			struct shared_awaiter
+			{
+				SharedResource<R> shared;
+				executor* exec;
+
+				bool await_ready() const { return shared.ready.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+				void await_suspend(std::coroutine_handle<> h)
+				{
+					shared.token->then([exec = exec, h]{ exec->post([h]{ h.resume(); }); });
+				}
+				std::shared_ptr<R> await_resume()
+				{
+					shared.ready.get();
+					return std::move(shared.resource);
+				}
+			};
+
+			template<class U>
+			struct task_awaiter
+			{
+				async_task<U> task;
+				executor* exec;
+
+				bool await_ready() const { return false; }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<> h)
+				{
+					task.coroutine.promise().exec = exec;
+					task.coroutine.promise().continuation = h;
+					return task.coroutine;
+				}
+				U await_resume() { return task.coroutine.promise().get(); }
+			};
+
+			struct switch_awaiter
+			{
+				executor& target;
+
+				bool await_ready() const { return false; }
+				void await_suspend(std::coroutine_handle<> h) { target.post([h]{ h.resume(); }); }
+				void await_resume() {}
+			};
+
+			struct promise_type : async_result<T>
+			{
+				executor* exec = nullptr;
+				std::coroutine_handle<> continuation;
+				bool detached = false;
+
+				async_task get_return_object() { return async_task(handle::from_promise(*this)); }
+				std::suspend_always initial_suspend() noexcept { return {}; }
+				auto final_suspend() noexcept
+				{
+					struct final_awaiter
+					{
+						bool await_ready() noexcept { return false; }
+						std::coroutine_handle<> await_suspend(handle h) noexcept
+						{
+							promise_type& p = h.promise();
+							if(p.continuation)
+								return p.continuation;
+							if(p.detached)
+							{
+								if constexpr(std::is_void_v<T>)
+								{
+									if(p.error)
+										report_detached(p.error);
+								}
+								h.destroy();
+							}
+							return std::noop_coroutine();
+						}
+						void await_resume() noexcept {}
+					};
+					return final_awaiter{};
+				}
+
+				load_awaiter await_transform(LoadFuture future)
+				{
+					return {std::move(future), exec};
+				}
+				template<class R>
+				shared_awaiter<R> await_transform(SharedResource<R> shared)
+				{
+					return {std::move(shared), exec};
+				}
+				template<class U>
+				task_awaiter<U> await_transform(async_task<U> task)
+				{
+					return {std::move(task), exec};
+				}
+				switch_awaiter await_transform(resume_on r)
+				{
+					exec = &r.target;
+					return {r.target};
+				}
+			};
+
+			async_task(async_task&& other) noexcept : coroutine(std::exchange(other.coroutine, nullptr)) {}
+			async_task& operator=(async_task&& other) noexcept
+			{
+				if(this != &other)
+				{
+					if(coroutine)
+						coroutine.destroy();
+					coroutine = std::exchange(other.coroutine, nullptr);
+				}
+				return *this;
+			}
+			~async_task()
+			{
+				if(coroutine)
+					coroutine.destroy();
+			}
+
+			// Gives up ownership of a coroutine that has not started yet, it destroys itself when done
+			handle detach(executor& exec)
+			{
+				coroutine.promise().exec = &exec;
+				coroutine.promise().detached = true;
+				return std::exchange(coroutine, nullptr);
+			}
+		private:
+			explicit async_task(handle coroutine) : coroutine(coroutine) {}
+			template<class U>
+			friend class async_task;
+
+			handle coroutine;
+	};
+
+	// Starts a coroutine on an executor without anyone waiting for it
+	inline void spawn(executor& exec, async_task<void> task)
+	{
+		auto h = task.detach(exec);
+		exec.post([h]{ h.resume(); });
+	}
+}
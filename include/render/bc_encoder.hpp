@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace render
+{
+	// Bytes of a block compressed image, partial blocks at the right and bottom edge count as whole ones
+	size_t bc_size(uint32_t width, uint32_t height, size_t blockSize);
+
+	// Compress an RGBA8 image into 4x4 blocks, blocks is written row by row. Edge texels are repeated to fill partial blocks.
+	// BC1 ignores alpha, BC3 keeps it as a separate 8 bit channel.
+	void encode_bc1(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks);
+	void encode_bc3(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks);
+}
@@ -29,11 +29,12 @@ namespace render
 
 			void preload(FT_Library ft, resource_loader* loader, vk::RenderPass renderPass);
 			void prepare(int imageCount);
-			void renderText(vk::CommandBuffer cmd, int frame, std::string text, float x, float y, float scale = 1.0f, glm::vec4 color = glm::vec4(1.0, 1.0, 1.0, 1.0));
+			// Draws nothing until the font texture is at least recorded, adds the wait for its upload to waits while it is in flight
+			void renderText(vk::CommandBuffer cmd, upload_waits& waits, int frame, std::string text, float x, float y, float scale = 1.0f, glm::vec4 color = glm::vec4(1.0, 1.0, 1.0, 1.0));
 			void finish(int frame);
 
 			std::unique_ptr<texture> fontTexture;
-			std::shared_future<void> textureReady;
+			LoadFuture textureReady;
 			vk::UniqueSampler sampler;
 
 			vk::UniquePipelineLayout pipelineLayout;
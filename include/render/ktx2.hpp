@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+#include <vulkan/vulkan.hpp>
+
+namespace render
+{
+	using ktx2_values = std::vector<std::pair<std::string_view, std::span<const std::byte>>>;
+
+	// The subset of KTX 2.0 the loader uploads directly: one 2D image in a BC1/3/5/7 format without supercompression
+	struct ktx2_image
+	{
+		vk::Format format;
+		uint32_t width;
+		uint32_t height;
+		std::vector<std::span<const std::byte>> levels; // level 0 is the largest
+		ktx2_values values;
+
+		// Empty if there is no such key
+		std::span<const std::byte> value(std::string_view key) const;
+	};
+
+	// Bytes per 4x4 block of the supported formats, 0 for all others
+	size_t block_size(vk::Format format);
+
+	// Both spans point into data, throws std::runtime_error for anything outside the subset above
+	ktx2_image parse_ktx2(std::span<const std::byte> data);
+	std::vector<std::byte> write_ktx2(vk::Format format, uint32_t width, uint32_t height,
+		const std::vector<std::span<const std::byte>>& levels, const ktx2_values& values);
+}
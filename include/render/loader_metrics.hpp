@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace render
+{
+	enum LoadStage
+	{
+		StageQueued, // waiting for a decoder or a submitter
+		StageRead, // opening and reading files
+		StageDecode, // CPU work of the decoder
+		StageStaging, // recording, i.e. copying into staging memory
+		StageTransfer, // from the queue submission until the loader sees the fence signaled
+		StageFenceWait, // blocked on the fence
+
+		LoadStageCount
+	};
+	const char* stage_name(LoadStage stage);
+
+	// Lock-free histogram of durations, buckets grow by a factor of 2^(1/4), so percentiles are within 20%
+	class latency_histogram
+	{
+		public:
+			void record(std::chrono::nanoseconds time);
+
+			uint64_t count() const { return samples.load(std::memory_order_relaxed); }
+			std::chrono::nanoseconds mean() const;
+			// p in [0, 1]
+			std::chrono::nanoseconds percentile(double p) const;
+		private:
+			constexpr static unsigned int subBuckets = 4;
+			constexpr static unsigned int bucketCount = 64 * subBuckets;
+
+			std::array<std::atomic<uint64_t>, bucketCount> buckets{};
+			std::atomic<uint64_t> samples = 0;
+			std::atomic<uint64_t> sum = 0; // in nanoseconds
+	};
+
+	struct thread_metrics
+	{
+		std::atomic<uint64_t> tasks = 0;
+		std::atomic<uint64_t> bytes = 0; // read by decoders, staged by submitters
+		std::atomic<int64_t> busy = 0; // in nanoseconds
+
+		void record(uint64_t bytes, std::chrono::nanoseconds time);
+		// while the thread is working
+		double bytesPerSecond() const;
+	};
+
+	// Per task times, filled in by whoever does the work
+	struct task_timing
+	{
+		std::array<std::chrono::nanoseconds, LoadStageCount> stages{};
+		uint64_t bytes = 0;
+	};
+
+	// Adds the time until it goes out of scope to a stage
+	class stage_timer
+	{
+		public:
+			stage_timer(task_timing& timing, LoadStage stage) : time(timing.stages[stage]), start(std::chrono::steady_clock::now()) {}
+			~stage_timer() { time += std::chrono::steady_clock::now() - start; }
+		private:
+			std::chrono::nanoseconds& time;
+			std::chrono::steady_clock::time_point start;
+	};
+
+	// Everything can be read at any time from any thread
+	struct loader_metrics
+	{
+		loader_metrics(unsigned int decoderCount, unsigned int submitterCount)
+			: decoders(decoderCount), submitters(submitterCount) {}
+
+		// queue depth
+		std::atomic<size_t> waiting = 0; // for a decoder
+		std::atomic<size_t> decoded = 0; // waiting for a submitter
+		std::atomic<size_t> inFlight = 0; // recorded, transfer not done yet
+
+		std::array<latency_histogram, LoadStageCount> stages;
+		latency_histogram total; // from the load call until the task is done
+
+		std::vector<thread_metrics> decoders;
+		std::vector<thread_metrics> submitters;
+	};
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+namespace render
+{
+	// Read-only memory mapping of a whole file
+	class mapped_file
+	{
+		public:
+			// populate reads the whole file right away instead of faulting it in on first access
+			mapped_file(const std::string& filename, bool populate = false);
+			~mapped_file();
+
+			mapped_file(const mapped_file&) = delete;
+			mapped_file& operator=(const mapped_file&) = delete;
+
+			const uint8_t* data() const { return static_cast<const uint8_t*>(address); }
+			size_t size() const { return length; }
+			std::string_view view() const { return std::string_view(static_cast<const char*>(address), length); }
+		private:
+			void* address = nullptr;
+			size_t length = 0;
+	};
+}
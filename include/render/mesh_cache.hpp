@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "render/model.hpp"
+#include "render/mapped_file.hpp"
+
+namespace render
+{
+	// Layout of a .vkmesh file: header, source path, vertex array, index array, meshlet array, LOD array
+	struct mesh_cache_header
+	{
+		static constexpr std::array<char, 8> expectedMagic = {'V', 'K', 'M', 'E', 'S', 'H', 0, 0};
+		static constexpr uint32_t currentVersion = 7;
+
+		std::array<char, 8> magic;
+		uint32_t version;
+		uint32_t flags;
+		uint32_t pathLength;
+
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		uint64_t sourceHash;
+
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t vertexStride;
+		uint32_t indexStride;
+		uint32_t meshletCount;
+		uint32_t lodCount;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint64_t meshletOffset;
+		uint64_t lodOffset;
+
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	class cached_mesh
+	{
+		public:
+			cached_mesh(const std::string& filename) : file(filename, true) {}
+
+			const mesh_cache_header& header() const { return *reinterpret_cast<const mesh_cache_header*>(file.data()); }
+			std::string_view path() const { return file.view().substr(sizeof(mesh_cache_header), header().pathLength); }
+			std::span<const std::byte> vertices() const { return bytes(header().vertexOffset, uint64_t(header().vertexCount) * header().vertexStride); }
+			std::span<const std::byte> indices() const { return bytes(header().indexOffset, uint64_t(header().indexCount) * header().indexStride); }
+			std::span<const meshlet> meshlets() const
+			{
+				return std::span<const meshlet>(reinterpret_cast<const meshlet*>(file.data() + header().meshletOffset), header().meshletCount);
+			}
+			std::span<const model_lod> lods() const
+			{
+				return std::span<const model_lod>(reinterpret_cast<const model_lod*>(file.data() + header().lodOffset), header().lodCount);
+			}
+
+			size_t size() const { return file.size(); }
+		private:
+			mapped_file file;
+
+			std::span<const std::byte> bytes(uint64_t offset, uint64_t size) const
+			{
+				return std::span<const std::byte>(reinterpret_cast<const std::byte*>(file.data() + offset), size);
+			}
+	};
+
+	// Returns the cached mesh for an OBJ file if the cache is still valid for it and was built with the same options, nullptr otherwise
+	std::unique_ptr<cached_mesh> find_cached_mesh(const std::string& filename, const model_options& options);
+	// Stores the final buffer contents of a model, counts, format, bounds, meshlets and LODs are taken from the model
+	void store_cached_mesh(const std::string& filename, const model_options& options, std::string_view source,
+		const model& mesh, std::span<const std::byte> vertices, std::span<const std::byte> indices);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "render/model.hpp"
+
+namespace render
+{
+	constexpr unsigned int vertexCacheSize = 16;
+
+	// Average cache miss ratio: transformed vertices per triangle for a FIFO post-transform cache
+	float compute_acmr(const std::vector<uint32_t>& indices, size_t vertexCount, unsigned int cacheSize = vertexCacheSize);
+
+	// Tipsify (Sander et al. 2007), returns the first triangle of every cluster that starts with a cache flush
+	std::vector<uint32_t> optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertexCount, unsigned int cacheSize = vertexCacheSize);
+
+	// Reorders the clusters found by optimize_vertex_cache so outward facing ones are drawn first.
+	// Clusters are split further where that costs at most threshold times their ACMR.
+	void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<vertex_data>& vertices,
+		const std::vector<uint32_t>& clusters, float threshold = 1.05f, unsigned int cacheSize = vertexCacheSize);
+
+	// Sorts vertices by first use in the index buffer and drops unreferenced ones
+	void optimize_vertex_fetch(std::vector<vertex_data>& vertices, std::vector<uint32_t>& indices);
+}
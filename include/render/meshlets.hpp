@@ -0,0 +1,13 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "render/model.hpp"
+
+namespace render
+{
+	// Packs the triangles into meshlets in index buffer order, so run it after optimize_vertex_cache for tight clusters.
+	// The mesh is split into one range per thread and meshlets never cross those ranges.
+	std::vector<meshlet> build_meshlets(const std::vector<uint32_t>& indices, const std::vector<vertex_data>& vertices, unsigned int threads = 1);
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+namespace render
+{
+	// Appends the levels 1 to mipLevels-1 of an RGBA8 image, each a 2x2 box filter of the level before.
+	// With srgb the color channels are averaged in linear space, alpha always is.
+	void generate_mips(std::vector<uint8_t>& pixels, uint32_t width, uint32_t height, uint32_t mipLevels, bool srgb);
+}
@@ -5,6 +5,9 @@
 #include <vk_mem_alloc.hpp>
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <vector>
+
 namespace render
 {
 	struct vertex_data
@@ -16,6 +19,76 @@ namespace render
 		static std::array<vk::VertexInputAttributeDescription, 3> attributes(uint32_t binding);
 	};
 
+	// 16 instead of 32 bytes per vertex. The position is normalized to the model's min/max
+	// (position = min + value * (max - min)), the normal is octahedral encoded.
+	// Only formats every device supports for vertex buffers, which excludes three 16 bit components.
+	struct packed_vertex_data
+	{
+		std::array<uint16_t, 4> position; // w is always 1
+		std::array<int8_t, 2> normal;
+		std::array<int8_t, 2> padding;
+		std::array<uint16_t, 2> texCoord; // half floats
+
+		static std::array<vk::VertexInputAttributeDescription, 3> attributes(uint32_t binding);
+	};
+	static_assert(sizeof(packed_vertex_data) == 16);
+
+	enum class vertex_format : uint32_t
+	{
+		Full,
+		Packed
+	};
+
+	// A cluster of at most maxVertices vertices and maxTriangles triangles, stored as a contiguous range of the index buffer
+	struct meshlet
+	{
+		static constexpr uint32_t maxVertices = 64;
+		static constexpr uint32_t maxTriangles = 124;
+
+		glm::vec3 center;
+		float radius;
+		glm::vec3 coneAxis;
+		float coneCutoff; // 1 if the triangles face too many directions for cone culling
+
+		uint32_t firstIndex;
+		uint32_t triangleCount;
+		uint32_t vertexCount;
+
+		// true if every triangle of the meshlet faces away from the camera
+		bool backfacing(glm::vec3 cameraPosition) const
+		{
+			glm::vec3 d = center - cameraPosition;
+			return glm::dot(d, coneAxis) >= coneCutoff * glm::length(d) + radius;
+		}
+	};
+
+	// A range of the index buffer drawing the whole model at a lower level of detail
+	struct model_lod
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float error; // simplification error relative to the bounding box diagonal
+	};
+
+	struct model_options
+	{
+		static constexpr unsigned int maxLodCount = 5;
+
+		bool optimize = false; // reorder for the post-transform vertex cache, overdraw and vertex fetch
+		bool quantize = false; // store vertices as packed_vertex_data
+		bool meshlets = false; // split the mesh into meshlets for per-cluster culling
+		unsigned int lodCount = 0; // simplified levels of detail to generate, each with half the triangles of the previous one
+		// import straight into staging memory, so the mesh never exists as a whole on the CPU.
+		// Only possible without optimize, meshlets and LODs, streamed imports are not cached.
+		bool stream = false;
+
+		// identifies the options a cached mesh was built with
+		uint32_t flags() const
+		{
+			return (optimize ? 1 : 0) | (quantize ? 2 : 0) | (meshlets ? 4 : 0) | (std::min(lodCount, maxLodCount) << 3);
+		}
+	};
+
 	struct model
 	{
 		model(vk::Device device, vma::Allocator allocator);
@@ -31,10 +104,27 @@ namespace render
 
 		int vertexCount;
 		int indexCount;
+		vertex_format vertexFormat = vertex_format::Full;
+		vk::IndexType indexType = vk::IndexType::eUint32; // 16 bit whenever all vertices can be addressed with it
 
 		void create_buffers(int vertexCount, int indexCount);
+		void destroy_buffers();
+		uint32_t vertexStride() const;
+		uint32_t indexStride() const;
+
+		// Binds the vertex and index buffer with the matching index type
+		void bind(vk::CommandBuffer commandBuffer, uint32_t binding = 0) const;
+		void draw(vk::CommandBuffer commandBuffer, uint32_t lod = 0, uint32_t instanceCount = 1) const;
 
 		glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
 		glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+		std::vector<meshlet> meshlets; // cover lods[0] only
+		std::vector<model_lod> lods; // lods[0] is the full mesh
+
+		// Height in pixels of the bounding box diagonal at a distance from a perspective camera
+		float screen_size(float distance, float fovY, float viewportHeight) const;
+		// Coarsest level of detail whose error stays below maxError pixels at the given screen size
+		uint32_t select_lod(float screenSize, float maxError = 1.0f) const;
 	};
 }
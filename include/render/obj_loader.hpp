@@ -1,8 +1,12 @@
 #pragma once
 
 #include <istream>
+#include <string_view>
 #include <vector>
 #include <array>
+#include <functional>
+#include <memory>
+#include <span>
 
 #include <glm/glm.hpp>
 
@@ -10,5 +14,28 @@
 
 namespace render
 {
+	void load_obj(std::string_view data, std::vector<vertex_data>& vertices, std::vector<uint32_t>& indices, unsigned int threads = 1);
 	void load_obj(std::istream& in, std::vector<vertex_data>& vertices, std::vector<uint32_t>& indices);
+
+	// Two pass import for meshes that should never exist as a whole in memory. The constructor parses the
+	// attributes and numbers the unique vertices, emit() then produces the same vertices and indices as load_obj
+	// in batches of at most batchSize. Only the attributes and the vertex map are kept between the passes.
+	class obj_stream
+	{
+		public:
+			using batch_function = std::function<void(std::span<const vertex_data> vertices, std::span<const uint32_t> indices)>;
+
+			obj_stream(std::string_view data);
+			~obj_stream();
+
+			size_t vertexCount() const;
+			size_t indexCount() const;
+			glm::vec3 min() const;
+			glm::vec3 max() const;
+
+			void emit(const batch_function& batch, size_t batchSize = 64*1024) const;
+		private:
+			struct state;
+			std::unique_ptr<state> s;
+	};
 }
@@ -5,6 +5,8 @@
 #include <vk_mem_alloc.hpp>
 
 #include "render/resource_loader.hpp"
+#include "render/residency.hpp"
+#include "render/async.hpp"
 
 namespace render
 {
@@ -29,10 +31,13 @@ namespace render
 			vk::Device device;
 			vma::Allocator allocator;
 			resource_loader* loader;
+			residency_manager* residency;
+			frame_executor* renderExecutor;
 
 			uint32_t graphicsFamily;
 			vk::Queue graphicsQueue;
 
 			std::vector<std::shared_future<void>> loadingFutures;
+			upload_waits uploadWaits; // for the next graphics submit
 	};
 }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <span>
+
+#include <glm/glm.hpp>
+
+#include "render/model.hpp"
+
+namespace render
+{
+	uint16_t float_to_half(float value);
+	std::array<int8_t, 2> encode_octahedral(glm::vec3 normal);
+
+	// Packs vertices relative to the given bounds, which must contain all positions
+	void quantize_vertices(std::span<const vertex_data> vertices, glm::vec3 min, glm::vec3 max, packed_vertex_data* packed);
+	void quantize_vertices(const std::vector<vertex_data>& vertices, glm::vec3 min, glm::vec3 max, std::vector<packed_vertex_data>& packed);
+
+	// Rewrites the indices as uint16_t in place, the result occupies the first half of the vector's storage
+	std::span<const std::byte> narrow_indices(std::vector<uint32_t>& indices);
+}
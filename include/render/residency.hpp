@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+#include <vulkan/vulkan.hpp>
+#include <vk_mem_alloc.hpp>
+
+#include "render/resource_loader.hpp"
+
+namespace render
+{
+	enum class residency_state
+	{
+		Loading,
+		Resident,
+		Evicted,
+		Failed
+	};
+
+	// Everything needed to load a resource again after it was evicted
+	struct residency_entry
+	{
+		LoadType type;
+		std::string filename;
+		LoadPriority priority;
+		model_options modelOptions = {};
+		uint32_t mipLevels = 1;
+		vk::Format format = vk::Format::eR8G8B8A8Srgb;
+
+		SharedResource<void> shared; // texture or model, null while evicted
+		residency_state state = residency_state::Loading;
+		uint64_t lastUse = 0; // frame
+		vk::DeviceSize size = 0; // of the allocations, known once loaded
+		uint32_t generation = 0;
+	};
+
+	class residency_manager;
+
+	// Handle to a texture or model the residency_manager may evict whenever it was not used for a while
+	template<class T>
+	class resident
+	{
+		public:
+			resident() = default;
+
+			// Marks the resource as used by the current frame and returns it once it can be used, i.e. it is loaded or
+			// waits got a timeline wait for it. Evicted resources are loaded again, nullptr until then.
+			// The pointer is only valid for the current frame.
+			T* use(upload_waits& waits);
+			// The resource once it is loaded, without counting as a use
+			T* peek() const
+			{
+				return entry->state == residency_state::Resident ? static_cast<T*>(entry->shared.resource.get()) : nullptr;
+			}
+			// The current load for awaiting it, empty while evicted
+			SharedResource<T> loading() const
+			{
+				return SharedResource<T>{std::static_pointer_cast<T>(entry->shared.resource), entry->shared.ready, entry->shared.token};
+			}
+			// Changes whenever the resource is loaded again, image views and buffers bound before are gone by then
+			uint32_t generation() const { return entry->generation; }
+			residency_state state() const { return entry->state; }
+
+			explicit operator bool() const { return entry != nullptr; }
+		private:
+			resident(residency_manager* manager, std::shared_ptr<residency_entry> entry) : manager(manager), entry(std::move(entry)) {}
+			friend class residency_manager;
+
+			residency_manager* manager = nullptr;
+			std::shared_ptr<residency_entry> entry;
+	};
+
+	// Keeps textures and models loaded from files below a memory budget by evicting the least recently used ones
+	// and loading them again through the resource_loader once they are used. Only meant for the render thread.
+	// Without a configured budget it stays below a share of what VK_EXT_memory_budget (or VMA's estimate) reports
+	// for the device local heaps, which also accounts for everything else allocated by this or other processes.
+	class residency_manager
+	{
+		public:
+			residency_manager(vma::Allocator allocator, vk::PhysicalDeviceMemoryProperties memoryProperties, resource_loader* loader,
+				vk::Device device, unsigned int framesInFlight);
+			~residency_manager();
+
+			residency_manager(const residency_manager&) = delete;
+			residency_manager& operator=(const residency_manager&) = delete;
+
+			resident<texture> loadTexture(std::string filename, LoadPriority priority = Visible,
+				uint32_t mipLevels = 1, vk::Format format = vk::Format::eR8G8B8A8Srgb);
+			resident<model> loadModel(std::string filename, model_options options = {}, LoadPriority priority = Visible);
+
+			// Starts a new frame, must be called after waiting for the oldest frame in flight and before any use().
+			// Frees what was evicted once no frame in flight can use it anymore and evicts until the budget is met again.
+			void next_frame();
+
+			uint64_t frame() const { return currentFrame; }
+			// bytes textures and models may use, or the device local budget when none is configured
+			vk::DeviceSize budget() const { return lastBudget; }
+			// bytes of device local memory in use, counting only tracked resources when a budget is configured
+			vk::DeviceSize usage() const { return lastUsage; }
+			vk::DeviceSize residentBytes() const { return trackedBytes; }
+			size_t residentCount() const;
+			uint64_t evictions() const { return evictionCount; }
+			uint64_t reloads() const { return reloadCount; }
+		private:
+			template<class T>
+			friend class resident;
+			void* use(residency_entry& entry, upload_waits& waits);
+
+			vma::Allocator allocator;
+			vk::PhysicalDeviceMemoryProperties memoryProperties;
+			resource_loader* loader;
+			vk::Device device;
+			unsigned int framesInFlight;
+
+			std::vector<std::shared_ptr<residency_entry>> entries;
+			struct retired_resource
+			{
+				std::shared_ptr<void> resource;
+				vk::DeviceSize size;
+				uint64_t frame;
+			};
+			std::deque<retired_resource> retired;
+			vk::DeviceSize retiredBytes = 0;
+
+			uint64_t currentFrame = 1;
+			vk::DeviceSize trackedBytes = 0;
+			vk::DeviceSize lastBudget = 0;
+			vk::DeviceSize lastUsage = 0;
+			uint64_t evictionCount = 0;
+			uint64_t reloadCount = 0;
+
+			void load(residency_entry& entry);
+			// moves finished loads on to Resident or Failed
+			void poll(residency_entry& entry);
+			void retire(residency_entry& entry);
+			vk::DeviceSize allocation_size(const residency_entry& entry) const;
+			// bytes to free to stay within the budget
+			vk::DeviceSize excess();
+	};
+
+	template<class T>
+	T* resident<T>::use(upload_waits& waits)
+	{
+		return static_cast<T*>(manager->use(*entry, waits));
+	}
+}
@@ -1,13 +1,21 @@
 #pragma once
 
+#include <array>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
 #include <string>
 #include <variant>
 #include <thread>
 #include <mutex>
 #include <queue>
+#include <unordered_map>
 #include <condition_variable>
 #include <optional>
+#include <span>
 #include <future>
+#include <functional>
 
 #define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
 #include <vulkan/vulkan.hpp>
@@ -17,6 +25,8 @@
 
 #include "texture.hpp"
 #include "model.hpp"
+#include "loader_metrics.hpp"
+#include "staging_stream.hpp"
 
 namespace render
 {
@@ -28,13 +38,229 @@ namespace render
 		Model
 	};
 
+	enum LoadPriority
+	{
+		Critical, // something waits for it right now
+		Visible, // shown as soon as it is ready
+		Prefetch, // might be needed later
+
+		LoadPriorityCount
+	};
+
+	// A value of a submitter's timeline semaphore, the copies of a task are done on the GPU once it is reached
+	struct timeline_point
+	{
+		vk::Semaphore semaphore;
+		uint64_t value = 0;
+	};
+
+	// Shared by a task and its LoadFuture, whoever claims it first decides whether the task goes on
+	struct LoadToken
+	{
+		enum State
+		{
+			Waiting,
+			Running,
+			Cancelled
+		};
+		std::atomic<State> state = Waiting;
+		// Cleared while the resources of the task still belong to the transfer queue family
+		std::atomic<bool> owned = true;
+		// Set by the decoder before the task waits for a submitter, frees the image or buffers decoding created
+		std::function<void()> discard;
+
+		bool claim(State to)
+		{
+			State expected = Waiting;
+			return state.compare_exchange_strong(expected, to);
+		}
+
+		// Runs f once the promise of the task is fulfilled or abandoned, right away if that already happened
+		void then(std::function<void()> f)
+		{
+			std::unique_lock<std::mutex> l(continuationLock);
+			if(!completed)
+			{
+				continuations.push_back(std::move(f));
+				return;
+			}
+			l.unlock();
+			f();
+		}
+		bool done()
+		{
+			std::scoped_lock<std::mutex> l(continuationLock);
+			return completed;
+		}
+		// Called by the loader right after it fulfilled or abandoned the promise
+		void complete()
+		{
+			std::vector<std::function<void()>> run;
+			{
+				std::scoped_lock<std::mutex> l(continuationLock);
+				completed = true;
+				run.swap(continuations);
+			}
+			for(auto& f : run)
+				f();
+		}
+		// Set by the submitter once the task is recorded, long before the CPU learns that the transfer is done
+		void recorded(timeline_point point)
+		{
+			timelineSemaphore = point.semaphore;
+			timelineValue.store(point.value, std::memory_order_release);
+		}
+		std::optional<timeline_point> timeline() const
+		{
+			uint64_t value = timelineValue.load(std::memory_order_acquire);
+			if(value == 0)
+				return std::nullopt;
+			return timeline_point{timelineSemaphore, value};
+		}
+		private:
+			vk::Semaphore timelineSemaphore;
+			std::atomic<uint64_t> timelineValue = 0;
+
+			std::mutex continuationLock;
+			bool completed = false;
+			std::vector<std::function<void()>> continuations;
+	};
+
+	// Where uploadImage writes to, always a whole mip level of the first layer of a color image
+	struct image_region
+	{
+		vk::Extent2D extent; // of the mip level
+		uint32_t mipLevel = 0;
+		uint32_t blockHeight = 1; // texels per row of blocks for block compressed formats
+		vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal; // after the upload
+	};
+
 	using LoaderFunction = std::function<void(uint8_t*, size_t)>;
 	struct LoadTask
 	{
 		LoadType type;
-		std::variant<std::string, LoaderFunction> src;
+		std::variant<std::string, LoaderFunction, std::span<const std::byte>> src;
 		std::variant<texture*, model*, vk::Image, vk::Buffer> dst;
 		std::promise<void> promise;
+		model_options modelOptions = {};
+		vk::DeviceSize offset = 0; // of buffer uploads
+		vk::DeviceSize size = 0; // of data generated by a LoaderFunction for Buffer and Image tasks
+		image_region region = {};
+		LoadPriority priority = Visible;
+		std::shared_ptr<LoadToken> token = std::make_shared<LoadToken>();
+		std::shared_ptr<void> owner = nullptr; // keeps dst alive until its transfer is done
+		std::chrono::steady_clock::time_point queued = std::chrono::steady_clock::now();
+	};
+
+	class LoadFuture : public std::future<void>
+	{
+		public:
+			LoadFuture() = default;
+			LoadFuture(std::future<void> future, std::shared_ptr<LoadToken> token)
+				: std::future<void>(std::move(future)), token(std::move(token)) {}
+
+			// Fails while the task is being decoded or once it is recorded. Otherwise the task never touches its target again
+			// and the future fails with std::future_errc::broken_promise as soon as the loader drops it.
+			// Objects a decoded task already created in its target are freed right away, the target is as if never loaded.
+			bool cancel()
+			{
+				if(!token || !token->claim(LoadToken::Cancelled))
+					return false;
+				if(token->discard)
+					token->discard();
+				return true;
+			}
+			// Only with timeline semaphores and once the task is recorded
+			std::optional<timeline_point> timeline() const { return token ? token->timeline() : std::nullopt; }
+			// Runs f on the thread that finishes the task once the future is ready, f must not block
+			void then(std::function<void()> f)
+			{
+				if(token)
+					token->then(std::move(f));
+				else
+					f();
+			}
+		private:
+			std::shared_ptr<LoadToken> token;
+			friend class upload_waits;
+	};
+
+	// A resource owned by the loader's cache and everyone who requested it, usable once ready is
+	template<class T>
+	struct SharedResource
+	{
+		std::shared_ptr<T> resource;
+		std::shared_future<void> ready;
+		std::shared_ptr<LoadToken> token;
+	};
+
+	// Collects the uploads a submit uses while their transfers might still be in flight, so the GPU waits for them instead of the CPU
+	class upload_waits
+	{
+		public:
+			// Whether the resource can be used by the next submit, adds a wait for it if its transfer is not known to be done.
+			// Resources uploaded on a dedicated transfer family are only usable after resource_loader::acquire().
+			bool use(const LoadFuture& future);
+			template<class T>
+			bool use(const SharedResource<T>& shared)
+			{
+				return use(is_ready(shared.ready), shared.token.get());
+			}
+			void add(timeline_point point, vk::PipelineStageFlags stage);
+
+			bool empty() const { return semaphores.empty(); }
+			// Appends all waits to those of a submit and forgets them. Binary semaphores ignore their value,
+			// but a vk::TimelineSemaphoreSubmitInfo with one value per wait semaphore is needed once any wait is a timeline semaphore.
+			void append(std::vector<vk::Semaphore>& waitSemaphores, std::vector<uint64_t>& waitValues, std::vector<vk::PipelineStageFlags>& waitStages);
+		private:
+			std::vector<vk::Semaphore> semaphores;
+			std::vector<uint64_t> values;
+			std::vector<vk::PipelineStageFlags> stages;
+
+			template<class F>
+			static bool is_ready(const F& f) { return f.valid() && f.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+			bool use(bool ready, const LoadToken* token);
+	};
+
+	// FIFO per priority, lower priorities only get their turn once all higher ones are empty
+	template<class T>
+	class priority_queue
+	{
+		public:
+			void push(T&& t, LoadPriority priority) { queues[priority].push(std::move(t)); }
+			T pop()
+			{
+				for(auto& q : queues)
+				{
+					if(!q.empty())
+					{
+						T t = std::move(q.front());
+						q.pop();
+						return t;
+					}
+				}
+				throw std::out_of_range("pop from empty priority_queue");
+			}
+			bool empty() const { return size() == 0; }
+			size_t size() const
+			{
+				size_t n = 0;
+				for(auto& q : queues)
+					n += q.size();
+				return n;
+			}
+		private:
+			std::array<std::queue<T>, LoadPriorityCount> queues;
+	};
+
+	// Records the copies of a task whose CPU side work is done
+	using RecordFunction = std::function<void(staging_stream&)>;
+	struct DecodedTask
+	{
+		LoadTask task;
+		RecordFunction record;
+		task_timing timing;
+		std::chrono::steady_clock::time_point decodedAt;
 	};
 
 	class resource_loader
@@ -42,30 +268,90 @@ namespace render
 		public:
 			resource_loader(vk::Device device, vma::Allocator allocator,
 				uint32_t transferFamily, uint32_t graphicsFamily,
-				std::vector<vk::Queue> queues);
+				std::vector<vk::Queue> queues, bool textureCompressionBC = false, bool timelineSemaphore = false,
+				vk::Extent3D transferGranularity = vk::Extent3D(1, 1, 1));
 			~resource_loader();
 
-			std::future<void> loadTexture(texture* texture, std::string filename);
-			std::future<void> loadTexture(texture* texture, LoaderFunction loader);
+			LoadFuture loadTexture(texture* texture, std::string filename, LoadPriority priority = Visible);
+			LoadFuture loadTexture(texture* texture, LoaderFunction loader, LoadPriority priority = Visible);
+
+			LoadFuture loadModel(model* model, std::string filename, model_options options = {}, LoadPriority priority = Visible);
+
+			// Loads every file only once for the same options as long as someone holds the result, concurrent requests share one load.
+			// A file is loaded again once its modification time changes.
+			SharedResource<texture> loadSharedTexture(std::string filename, LoadPriority priority = Visible,
+				uint32_t mipLevels = 1, vk::Format format = vk::Format::eR8G8B8A8Srgb);
+			SharedResource<model> loadSharedModel(std::string filename, model_options options = {}, LoadPriority priority = Visible);
 
-			std::future<void> loadModel(model* model, std::string filename);
+			// Raw uploads through the same batched path. Data in spans is copied straight to staging memory while recording
+			// and has to stay valid until the future is ready. A LoaderFunction generates size bytes on a decoder thread instead.
+			// The graphics queue must not use the target while it is being written.
+			LoadFuture uploadBuffer(vk::Buffer buffer, vk::DeviceSize offset, std::span<const std::byte> data, LoadPriority priority = Visible);
+			LoadFuture uploadBuffer(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size, LoaderFunction loader, LoadPriority priority = Visible);
+			// The image needs eTransferDst usage, the previous content of the mip level is discarded. Data holds tightly packed rows.
+			LoadFuture uploadImage(vk::Image image, image_region region, std::span<const std::byte> data, LoadPriority priority = Visible);
+			LoadFuture uploadImage(vk::Image image, image_region region, vk::DeviceSize size, LoaderFunction loader, LoadPriority priority = Visible);
 
 			static vk::Extent2D getImageSize(std::string filename);
+
+			// Records the acquire half of the ownership transfers of everything uploaded on a dedicated transfer family so far
+			// and adds the waits for their transfers. Belongs at the start of every graphics command buffer,
+			// nothing uploaded on another family is usable before.
+			void acquire(vk::CommandBuffer cmd, upload_waits& waits);
+
+			const loader_metrics& metrics() const { return loaderMetrics; }
 		private:
 			vk::Device device;
 			vma::Allocator allocator;
 
 			uint32_t transferFamily;
 			uint32_t graphicsFamily;
+			bool textureCompressionBC; // the device feature, PNGs are transcoded and .ktx2 files accepted only with it
+			bool timelineSemaphore; // the device feature, tasks publish their timeline_point only with it
+			vk::Extent3D transferGranularity; // minImageTransferGranularity of transferFamily
 
+			// decoders turn tasks into DecodedTasks on all cores, one submitter per queue copies them to the GPU
 			std::mutex lock;
-			std::vector<std::thread> threads;
-			std::queue<LoadTask> tasks;
-			std::condition_variable cv;
+			std::vector<std::thread> decoders;
+			std::vector<std::thread> submitters;
+			priority_queue<LoadTask> tasks;
+			priority_queue<DecodedTask> decoded;
+			size_t maxDecoded;
+			unsigned int busyDecoders = 0; // decoding a task right now
+			std::condition_variable cv; // for decoders: new tasks or room in decoded
+			std::condition_variable decodedCv; // for submitters: new decoded tasks
 			bool quit = false;
 
-			void loadThread(int index, vk::Queue queue);
+			loader_metrics loaderMetrics;
+
+			struct pending_acquire
+			{
+				queue_acquire barriers;
+				std::shared_ptr<LoadToken> token;
+				std::optional<timeline_point> point; // only with timeline semaphores, otherwise the task has to be done
+				std::shared_ptr<void> owner;
+			};
+			std::mutex acquireLock;
+			std::vector<pending_acquire> acquires;
+
+			struct cache_entry
+			{
+				std::weak_ptr<void> resource;
+				std::shared_future<void> ready;
+				std::shared_ptr<LoadToken> token;
+			};
+			std::mutex cacheLock;
+			std::unordered_map<std::string, cache_entry> cache;
+
+			// canonical path, modification time and options
+			static std::string cache_key(const std::string& filename, const std::string& options);
+			template<class T>
+			SharedResource<T> find_shared(const std::string& key);
+
+			LoadFuture enqueue(LoadTask task);
+			void decodeThread(int index);
+			void submitThread(int index, vk::Queue queue);
 
-			constexpr static vk::DeviceSize stagingSize = 16*1024*1024;
+			constexpr static vk::DeviceSize stagingSize = 16*1024*1024; // per staging slot
 	};
 }
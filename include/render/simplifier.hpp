@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "render/model.hpp"
+
+namespace render
+{
+	// Quadric error edge collapse (Garland and Heckbert 1997) that only ever moves a vertex onto one of its neighbours,
+	// so the result still indexes the same vertex array. Border and seam vertices stay in place.
+	// Returns the largest collapse error as a distance in model space.
+	float simplify(std::vector<uint32_t>& indices, const std::vector<vertex_data>& vertices, size_t targetIndexCount);
+
+	// Appends up to lodCount simplified copies of the mesh to the index buffer, each with half the triangles of the one before.
+	// The returned ranges start with the original mesh, errors are measured against it relative to the bounding box diagonal.
+	std::vector<model_lod> generate_lods(std::vector<uint32_t>& indices, const std::vector<vertex_data>& vertices,
+		unsigned int lodCount, bool optimize);
+}
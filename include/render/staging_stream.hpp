@@ -0,0 +1,153 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <memory>
+#include <span>
+#include <vector>
+
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+#include <vulkan/vulkan.hpp>
+#include <vk_mem_alloc.hpp>
+
+#include "render/loader_metrics.hpp"
+
+namespace render
+{
+	// The acquire half of queue family ownership transfers, recorded by the queue family that uses the resources
+	struct queue_acquire
+	{
+		std::vector<vk::ImageMemoryBarrier> images;
+		std::vector<vk::BufferMemoryBarrier> buffers;
+
+		bool empty() const { return images.empty() && buffers.empty(); }
+	};
+
+	// Uploads data of any size through a ring of persistently mapped staging buffers.
+	// Each slot of the ring has its own command buffer and fence. Tasks are batched into a slot until it runs full,
+	// holds batchSize tasks or the first of them waited for batchLatency. Then recording continues in the next slot
+	// while the transfer of the previous one is in flight. Slots are only waited for when they are about to be reused.
+	// With timeline semaphores every submission also signals the next value of the stream's semaphore.
+	class staging_stream
+	{
+		public:
+			// ownerFamily is the queue family using the uploaded resources, granularity the minImageTransferGranularity of queueFamily
+			staging_stream(vk::Device device, vma::Allocator allocator, vk::Queue queue, uint32_t queueFamily, uint32_t ownerFamily,
+				unsigned int slotCount, vk::DeviceSize slotSize, unsigned int batchSize, std::chrono::milliseconds batchLatency,
+				bool timelineSemaphore = false, loader_metrics* metrics = nullptr, vk::Extent3D granularity = vk::Extent3D(1, 1, 1));
+			~staging_stream();
+
+			staging_stream(const staging_stream&) = delete;
+			staging_stream& operator=(const staging_stream&) = delete;
+
+			// Returns staging memory for size bytes that end up in dst at offset, size must not exceed the slot size
+			uint8_t* reserve(vk::Buffer dst, vk::DeviceSize offset, vk::DeviceSize size);
+			void write(vk::Buffer dst, vk::DeviceSize offset, std::span<const std::byte> data);
+
+			// Returns staging memory for the tightly packed rows [y, y+rows) of an image in eTransferDstOptimal layout.
+			// For block compressed formats a row is a row of blocks, each blockHeight texels high.
+			uint8_t* reserve_rows(vk::Image dst, uint32_t mipLevel, vk::Extent2D extent, uint32_t y, uint32_t rows, vk::DeviceSize rowSize,
+				uint32_t blockHeight = 1);
+			// Uploads a whole mip level in chunks of as many rows as fit into a slot, rounded down to the transfer granularity
+			void write_image(vk::Image dst, uint32_t mipLevel, vk::Extent2D extent, std::span<const std::byte> data, uint32_t blockHeight = 1);
+
+			// Ends the upload of a resource, after all of its copies. On the owner family this is a plain barrier,
+			// otherwise the release half of an ownership transfer whose acquire half is kept for take_acquires().
+			void release(vk::Image image, vk::ImageSubresourceRange range, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+				vk::AccessFlags dstAccess);
+			void release(vk::Buffer buffer, vk::AccessFlags dstAccess, vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE);
+			// The acquire barriers of everything released since the last call
+			queue_acquire take_acquires();
+
+			// Ends a task, the promise is fulfilled (or fails with error) once the transfer of everything recorded so far is done.
+			// owner is released at the same time. With metrics the time since queued ends up in their total.
+			void submit(std::promise<void> promise, std::exception_ptr error = nullptr, std::shared_ptr<void> owner = nullptr,
+				std::chrono::steady_clock::time_point queued = {});
+			// Submits the open batch
+			void flush();
+			// Retires the oldest slots as long as their transfers are already done and submits the open batch once it is due
+			void poll();
+			// Submits the open batch and waits for all transfers in flight
+			void drain();
+			bool busy() const;
+			// Whether the open batch holds tasks and when it has to be submitted at the latest
+			bool batching() const;
+			std::chrono::steady_clock::time_point deadline() const { return batchStart + batchLatency; }
+
+			vk::DeviceSize size() const { return slotSize; }
+			// bytes written to staging memory so far
+			uint64_t staged() const { return stagedBytes; }
+
+			// The GPU is done with everything recorded so far once the semaphore reaches signalValue(), null without timeline semaphores.
+			// The value might not be submitted yet, which is fine for waits on the GPU.
+			vk::Semaphore semaphore() const { return timeline.get(); }
+			uint64_t signalValue() const { return submissions + 1; }
+
+			// For recording additional commands, they are ordered after all copies written so far
+			vk::CommandBuffer commandBuffer();
+		private:
+			struct completion
+			{
+				std::promise<void> promise;
+				std::exception_ptr error;
+				std::shared_ptr<void> owner;
+				std::chrono::steady_clock::time_point queued;
+			};
+			struct slot
+			{
+				vk::UniqueCommandPool pool;
+				vk::UniqueCommandBuffer commandBuffer;
+				vk::UniqueFence fence;
+
+				vk::Buffer buffer;
+				vma::Allocation allocation;
+				uint8_t* memory = nullptr;
+
+				bool inFlight = false;
+				std::chrono::steady_clock::time_point submitted;
+				std::vector<completion> completions;
+			};
+
+			vk::Device device;
+			vma::Allocator allocator;
+			vk::Queue queue;
+			uint32_t queueFamily;
+			uint32_t ownerFamily;
+			vk::Extent3D granularity;
+			queue_acquire acquires;
+			vk::DeviceSize slotSize;
+			unsigned int batchSize;
+			std::chrono::milliseconds batchLatency;
+			std::chrono::steady_clock::time_point batchStart;
+			loader_metrics* metrics;
+			uint64_t stagedBytes = 0;
+
+			vk::UniqueSemaphore timeline;
+			uint64_t submissions = 0;
+
+			std::vector<slot> slots;
+			size_t current = 0;
+			vk::DeviceSize used = 0;
+			bool recording = false;
+
+			// consecutive writes to the same buffer are merged into a single copy
+			vk::Buffer pendingBuffer;
+			vk::BufferCopy pending;
+			// and consecutive rows of an image into a single region
+			vk::Image pendingImage;
+			std::vector<vk::BufferImageCopy> pendingRegions;
+			vk::DeviceSize pendingRowSize = 0;
+			uint32_t pendingRows = 0; // in the last region
+			uint32_t pendingBlockHeight = 1;
+
+			vk::DeviceSize allocate(vk::DeviceSize size, bool contiguous);
+
+			void begin();
+			void record();
+			// ends and submits the current slot and moves on to the next one
+			void submit_slot();
+			void retire(slot& s);
+	};
+}
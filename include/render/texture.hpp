@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 #define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
 #include <vulkan/vulkan.hpp>
 #include <vk_mem_alloc.hpp>
@@ -12,21 +14,29 @@ namespace render
 			vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eSampled,
 			vk::Format format = vk::Format::eR8G8B8A8Srgb,
 			vk::SampleCountFlagBits sampleCount = vk::SampleCountFlagBits::e1,
-			bool transfer = true, vk::ImageAspectFlags aspects = vk::ImageAspectFlagBits::eColor);
+			bool transfer = true, vk::ImageAspectFlags aspects = vk::ImageAspectFlagBits::eColor, uint32_t mipLevels = 1);
 		texture(vk::Device device, vma::Allocator allocator, vk::Extent2D extent, 
 			vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eSampled,
 			vk::Format format = vk::Format::eR8G8B8A8Srgb,
 			vk::SampleCountFlagBits sampleCount = vk::SampleCountFlagBits::e1,
-			bool transfer = true, vk::ImageAspectFlags aspects = vk::ImageAspectFlagBits::eColor) 
-			: texture(device, allocator, extent.width, extent.height, usage, format, sampleCount, transfer, aspects) {}
+			bool transfer = true, vk::ImageAspectFlags aspects = vk::ImageAspectFlagBits::eColor, uint32_t mipLevels = 1) 
+			: texture(device, allocator, extent.width, extent.height, usage, format, sampleCount, transfer, aspects, mipLevels) {}
 		
 		texture(vk::Device device, vma::Allocator allocator, 
 			vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eSampled,
 			vk::Format format = vk::Format::eR8G8B8A8Srgb,
 			vk::SampleCountFlagBits sampleCount = vk::SampleCountFlagBits::e1,
-			bool transfer = true, vk::ImageAspectFlags aspects = vk::ImageAspectFlagBits::eColor);
+			bool transfer = true, vk::ImageAspectFlags aspects = vk::ImageAspectFlagBits::eColor, uint32_t mipLevels = 1);
 		~texture();
 		void create_image(int width, int height);
+		// Overrides the format and limits the mip chain, e.g. to the levels stored in a file
+		void create_image(int width, int height, vk::Format format, uint32_t availableMipLevels);
+		// Frees what create_image created
+		void destroy_image();
+
+		// mipLevels for a chain down to 1x1
+		static constexpr uint32_t fullMipChain = 0;
+		static uint32_t mip_count(int width, int height);
 		void name(std::string name);
 
 		vk::Device device;
@@ -37,6 +47,8 @@ namespace render
 
 		int width;
 		int height;
+		vk::Format format;
+		uint32_t mipLevels;
 
 		vk::UniqueImageView imageView;
 
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "render/ktx2.hpp"
+#include "render/mapped_file.hpp"
+
+namespace render
+{
+	// A block compressed texture, either mapped from a .ktx2 file or freshly transcoded into memory
+	class cached_texture
+	{
+		public:
+			cached_texture(const std::string& filename);
+			cached_texture(std::vector<std::byte> data);
+
+			const ktx2_image& image() const { return parsed; }
+			size_t size() const { return file ? file->size() : owned.size(); }
+		private:
+			std::unique_ptr<mapped_file> file;
+			std::vector<std::byte> owned;
+			ktx2_image parsed;
+	};
+
+	// Returns the transcoded texture of a PNG file if the cache was built from the same content with the same options, nullptr otherwise
+	std::unique_ptr<cached_texture> find_cached_texture(const std::string& filename, std::span<const std::byte> source, bool srgb, bool mips);
+	// Compresses RGBA8 pixels to BC1, or BC3 if any texel is not opaque, with a full mip chain if mips is set.
+	// The result is stored in the cache and returned.
+	std::unique_ptr<cached_texture> transcode_texture(const std::string& filename, std::span<const std::byte> source,
+		std::vector<uint8_t> pixels, uint32_t width, uint32_t height, bool srgb, bool mips);
+}
@@ -13,6 +13,8 @@
 
 #include "phase.hpp"
 #include "resource_loader.hpp"
+#include "residency.hpp"
+#include "async.hpp"
 
 namespace render
 {
@@ -45,6 +47,8 @@ namespace render
 			void set_phase(phase* renderer);
 
 			std::unique_ptr<resource_loader> loader;
+			std::unique_ptr<residency_manager> residency;
+			frame_executor renderExecutor; // runs on the render thread between frames
 
 			std::unique_ptr<phase> current_renderer;
 
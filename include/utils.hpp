@@ -3,6 +3,7 @@
 #include <future>
 #include <sstream>
 #include <iomanip>
+#include <cstdint>
 
 #include <glm/glm.hpp>
 
@@ -18,6 +19,9 @@ namespace utils
 
 	std::string to_fixed_string(double d, int n);
 
+	// Fast non-cryptographic 64-bit hash for detecting changed file contents
+	uint64_t content_hash(const void* data, size_t size);
+
 	template<int n, typename T>
 	std::string to_fixed_string(T d)
 	{
@@ -0,0 +1,198 @@
+#include "render/bc_encoder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace render
+{
+	namespace
+	{
+		using block = std::array<uint8_t, 64>; // 4x4 RGBA8 texels
+
+		block fetch_block(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by)
+		{
+			block b;
+			for(uint32_t y=0; y<4; y++)
+			{
+				uint32_t sy = std::min(by*4 + y, height-1);
+				for(uint32_t x=0; x<4; x++)
+				{
+					uint32_t sx = std::min(bx*4 + x, width-1);
+					std::memcpy(&b[(y*4+x)*4], rgba + (size_t(sy)*width + sx)*4, 4);
+				}
+			}
+			return b;
+		}
+
+		uint16_t to_565(const float c[3])
+		{
+			auto q = [](float v, int max){
+				return static_cast<uint16_t>(std::clamp(static_cast<int>(v * max / 255.0f + 0.5f), 0, max));
+			};
+			return q(c[0], 31) << 11 | q(c[1], 63) << 5 | q(c[2], 31);
+		}
+
+		std::array<int, 3> from_565(uint16_t c)
+		{
+			int r = c >> 11, g = (c >> 5) & 63, b = c & 31;
+			return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+		}
+
+		// endpoints on the principal axis of the block's colors, inset a little because the extremes are rarely hit exactly
+		void encode_color(const block& b, uint8_t* out)
+		{
+			float mean[3] = {0, 0, 0};
+			for(int i=0; i<16; i++)
+				for(int c=0; c<3; c++)
+					mean[c] += b[i*4+c];
+			for(int c=0; c<3; c++)
+				mean[c] /= 16.0f;
+
+			float cov[6] = {0, 0, 0, 0, 0, 0};
+			for(int i=0; i<16; i++)
+			{
+				float r = b[i*4+0] - mean[0], g = b[i*4+1] - mean[1], bl = b[i*4+2] - mean[2];
+				cov[0] += r*r; cov[1] += r*g; cov[2] += r*bl;
+				cov[3] += g*g; cov[4] += g*bl; cov[5] += bl*bl;
+			}
+
+			// power iteration, starting from the diagonal favours the channel with the largest spread
+			float axis[3] = {cov[0], cov[3], cov[5]};
+			for(int it=0; it<8; it++)
+			{
+				float x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+				float y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+				float z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+				float m = std::max({std::abs(x), std::abs(y), std::abs(z)});
+				if(m == 0.0f)
+					break;
+				axis[0] = x/m; axis[1] = y/m; axis[2] = z/m;
+			}
+
+			float lo = 0, hi = 0;
+			for(int i=0; i<16; i++)
+			{
+				float t = (b[i*4+0]-mean[0])*axis[0] + (b[i*4+1]-mean[1])*axis[1] + (b[i*4+2]-mean[2])*axis[2];
+				lo = std::min(lo, t);
+				hi = std::max(hi, t);
+			}
+			float len = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+			float inset = (hi - lo) / 16.0f;
+			lo = len > 0 ? (lo + inset) / len : 0;
+			hi = len > 0 ? (hi - inset) / len : 0;
+
+			float c0[3], c1[3];
+			for(int c=0; c<3; c++)
+			{
+				c0[c] = mean[c] + axis[c]*hi;
+				c1[c] = mean[c] + axis[c]*lo;
+			}
+			uint16_t e0 = to_565(c0), e1 = to_565(c1);
+			// e0 > e1 selects the four color mode
+			if(e0 < e1)
+				std::swap(e0, e1);
+
+			uint32_t indices = 0;
+			if(e0 != e1)
+			{
+				auto p0 = from_565(e0), p1 = from_565(e1);
+				std::array<std::array<int, 3>, 4> palette;
+				for(int c=0; c<3; c++)
+				{
+					palette[0][c] = p0[c];
+					palette[1][c] = p1[c];
+					palette[2][c] = (2*p0[c] + p1[c]) / 3;
+					palette[3][c] = (p0[c] + 2*p1[c]) / 3;
+				}
+				for(int i=0; i<16; i++)
+				{
+					int best = 0, bestError = INT32_MAX;
+					for(int p=0; p<4; p++)
+					{
+						int dr = b[i*4+0]-palette[p][0], dg = b[i*4+1]-palette[p][1], db = b[i*4+2]-palette[p][2];
+						int error = dr*dr + dg*dg + db*db;
+						if(error < bestError)
+						{
+							bestError = error;
+							best = p;
+						}
+					}
+					indices |= uint32_t(best) << (i*2);
+				}
+			}
+
+			std::memcpy(out+0, &e0, 2);
+			std::memcpy(out+2, &e1, 2);
+			std::memcpy(out+4, &indices, 4);
+		}
+
+		// BC4 style: two endpoints and eight interpolated values
+		void encode_alpha(const block& b, uint8_t* out)
+		{
+			int lo = 255, hi = 0;
+			for(int i=0; i<16; i++)
+			{
+				lo = std::min<int>(lo, b[i*4+3]);
+				hi = std::max<int>(hi, b[i*4+3]);
+			}
+			out[0] = hi;
+			out[1] = lo;
+
+			uint64_t indices = 0;
+			if(hi != lo)
+			{
+				std::array<int, 8> palette = {hi, lo};
+				for(int p=1; p<7; p++)
+					palette[p+1] = ((7-p)*hi + p*lo) / 7;
+				for(int i=0; i<16; i++)
+				{
+					int best = 0, bestError = INT32_MAX;
+					for(int p=0; p<8; p++)
+					{
+						int error = std::abs(b[i*4+3] - palette[p]);
+						if(error < bestError)
+						{
+							bestError = error;
+							best = p;
+						}
+					}
+					indices |= uint64_t(best) << (i*3);
+				}
+			}
+			for(int i=0; i<6; i++)
+				out[2+i] = static_cast<uint8_t>(indices >> (i*8));
+		}
+	}
+
+	size_t bc_size(uint32_t width, uint32_t height, size_t blockSize)
+	{
+		return size_t((width+3)/4) * ((height+3)/4) * blockSize;
+	}
+
+	void encode_bc1(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks)
+	{
+		for(uint32_t by=0; by<(height+3)/4; by++)
+		{
+			for(uint32_t bx=0; bx<(width+3)/4; bx++)
+			{
+				encode_color(fetch_block(rgba, width, height, bx, by), blocks);
+				blocks += 8;
+			}
+		}
+	}
+
+	void encode_bc3(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks)
+	{
+		for(uint32_t by=0; by<(height+3)/4; by++)
+		{
+			for(uint32_t bx=0; bx<(width+3)/4; bx++)
+			{
+				block b = fetch_block(rgba, width, height, bx, by);
+				encode_alpha(b, blocks);
+				encode_color(b, blocks+8);
+				blocks += 16;
+			}
+		}
+	}
+}
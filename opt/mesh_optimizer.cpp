@@ -0,0 +1,265 @@
+#include "render/mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace render
+{
+	namespace
+	{
+		class fifo_cache
+		{
+			public:
+				fifo_cache(size_t vertexCount, unsigned int cacheSize) : timestamps(vertexCount, 0), time(cacheSize+1), size(cacheSize) {}
+
+				// returns true on a cache miss
+				bool access(uint32_t vertex)
+				{
+					if(time - timestamps[vertex] > size)
+					{
+						timestamps[vertex] = time++;
+						return true;
+					}
+					return false;
+				}
+
+				void clear()
+				{
+					time += size+1;
+				}
+			private:
+				std::vector<uint64_t> timestamps;
+				uint64_t time;
+				unsigned int size;
+		};
+
+		struct adjacency
+		{
+			std::vector<uint32_t> offsets;
+			std::vector<uint32_t> triangles;
+
+			adjacency(const std::vector<uint32_t>& indices, size_t vertexCount) : offsets(vertexCount+1, 0), triangles(indices.size())
+			{
+				for(uint32_t v : indices)
+					offsets[v+1]++;
+				std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+				std::vector<uint32_t> fill(offsets.begin(), offsets.end()-1);
+				for(size_t i=0; i<indices.size(); i++)
+					triangles[fill[indices[i]]++] = i/3;
+			}
+		};
+	}
+
+	float compute_acmr(const std::vector<uint32_t>& indices, size_t vertexCount, unsigned int cacheSize)
+	{
+		if(indices.empty())
+			return 0.0f;
+
+		fifo_cache cache(vertexCount, cacheSize);
+		size_t misses = 0;
+		for(uint32_t v : indices)
+			misses += cache.access(v);
+		return static_cast<float>(misses) / (indices.size()/3);
+	}
+
+	std::vector<uint32_t> optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertexCount, unsigned int cacheSize)
+	{
+		std::vector<uint32_t> clusters;
+		size_t triangleCount = indices.size()/3;
+		if(triangleCount == 0)
+			return clusters;
+
+		adjacency adj(indices, vertexCount);
+		std::vector<uint32_t> live(vertexCount);
+		for(size_t v=0; v<vertexCount; v++)
+			live[v] = adj.offsets[v+1] - adj.offsets[v];
+
+		std::vector<uint64_t> cacheTime(vertexCount, 0);
+		uint64_t timestamp = cacheSize+1;
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEnd;
+		std::vector<uint32_t> candidates;
+		size_t cursor = 0;
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+
+		int64_t fanning = indices[0];
+		bool flushed = true;
+		while(fanning >= 0)
+		{
+			if(flushed)
+				clusters.push_back(result.size()/3);
+
+			candidates.clear();
+			for(uint32_t i = adj.offsets[fanning]; i < adj.offsets[fanning+1]; i++)
+			{
+				uint32_t t = adj.triangles[i];
+				if(emitted[t])
+					continue;
+				emitted[t] = true;
+
+				for(int k=0; k<3; k++)
+				{
+					uint32_t v = indices[t*3+k];
+					result.push_back(v);
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					live[v]--;
+					if(timestamp - cacheTime[v] > cacheSize)
+						cacheTime[v] = timestamp++;
+				}
+			}
+
+			// prefer the candidate that stays in the cache while its remaining triangles are emitted
+			fanning = -1;
+			int64_t bestPriority = -1;
+			for(uint32_t v : candidates)
+			{
+				if(live[v] == 0)
+					continue;
+				int64_t priority = 0;
+				if(timestamp - cacheTime[v] + 2*live[v] <= cacheSize)
+					priority = timestamp - cacheTime[v];
+				if(priority > bestPriority)
+				{
+					bestPriority = priority;
+					fanning = v;
+				}
+			}
+
+			flushed = false;
+			if(fanning < 0)
+			{
+				while(!deadEnd.empty() && fanning < 0)
+				{
+					uint32_t v = deadEnd.back();
+					deadEnd.pop_back();
+					if(live[v] > 0)
+						fanning = v;
+				}
+				while(fanning < 0 && cursor < vertexCount)
+				{
+					if(live[cursor] > 0)
+					{
+						fanning = cursor;
+						flushed = true;
+					}
+					cursor++;
+				}
+			}
+		}
+
+		indices = std::move(result);
+		return clusters;
+	}
+
+	void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<vertex_data>& vertices,
+		const std::vector<uint32_t>& hardClusters, float threshold, unsigned int cacheSize)
+	{
+		size_t triangleCount = indices.size()/3;
+		if(triangleCount == 0 || hardClusters.empty())
+			return;
+
+		// split the hard clusters wherever a prefix is already about as cache friendly as the whole cluster
+		std::vector<uint32_t> clusters;
+		fifo_cache cache(vertices.size(), cacheSize);
+		for(size_t c=0; c<hardClusters.size(); c++)
+		{
+			uint32_t begin = hardClusters[c];
+			uint32_t end = c+1 < hardClusters.size() ? hardClusters[c+1] : triangleCount;
+
+			cache.clear();
+			size_t clusterMisses = 0;
+			for(uint32_t t=begin; t<end; t++)
+				for(int k=0; k<3; k++)
+					clusterMisses += cache.access(indices[t*3+k]);
+			float clusterThreshold = threshold * clusterMisses / (end-begin);
+
+			cache.clear();
+			size_t misses = 0;
+			uint32_t start = begin;
+			clusters.push_back(begin);
+			for(uint32_t t=begin; t<end; t++)
+			{
+				for(int k=0; k<3; k++)
+					misses += cache.access(indices[t*3+k]);
+				if(t+1 < end && static_cast<float>(misses) / (t+1-start) <= clusterThreshold)
+				{
+					clusters.push_back(t+1);
+					start = t+1;
+					misses = 0;
+					cache.clear();
+				}
+			}
+		}
+
+		glm::vec3 meshCentroid(0.0f);
+		for(const vertex_data& v : vertices)
+			meshCentroid += v.position;
+		meshCentroid = meshCentroid / static_cast<float>(std::max<size_t>(vertices.size(), 1));
+
+		// clusters far out along their normal are likely to occlude the others, so they go first
+		std::vector<float> sortKeys(clusters.size());
+		for(size_t c=0; c<clusters.size(); c++)
+		{
+			uint32_t begin = clusters[c];
+			uint32_t end = c+1 < clusters.size() ? clusters[c+1] : triangleCount;
+
+			glm::vec3 centroid(0.0f);
+			glm::vec3 normal(0.0f);
+			float area = 0.0f;
+			for(uint32_t t=begin; t<end; t++)
+			{
+				glm::vec3 p0 = vertices[indices[t*3+0]].position;
+				glm::vec3 p1 = vertices[indices[t*3+1]].position;
+				glm::vec3 p2 = vertices[indices[t*3+2]].position;
+				glm::vec3 n = glm::cross(p1-p0, p2-p0);
+				float triangleArea = glm::length(n);
+
+				centroid += (p0+p1+p2) * (triangleArea/3.0f);
+				normal += n;
+				area += triangleArea;
+			}
+			if(area > 0.0f)
+				centroid = centroid / area;
+			float length = glm::length(normal);
+			sortKeys[c] = length > 0.0f ? glm::dot(centroid - meshCentroid, normal / length) : 0.0f;
+		}
+
+		std::vector<uint32_t> order(clusters.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t a, uint32_t b){
+			return sortKeys[a] > sortKeys[b];
+		});
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+		for(uint32_t c : order)
+		{
+			uint32_t begin = clusters[c];
+			uint32_t end = c+1 < clusters.size() ? clusters[c+1] : triangleCount;
+			result.insert(result.end(), indices.begin() + begin*3, indices.begin() + end*3);
+		}
+		indices = std::move(result);
+	}
+
+	void optimize_vertex_fetch(std::vector<vertex_data>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+		std::vector<vertex_data> result;
+		result.reserve(vertices.size());
+
+		for(uint32_t& index : indices)
+		{
+			if(remap[index] == UINT32_MAX)
+			{
+				remap[index] = result.size();
+				result.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices = std::move(result);
+	}
+}
@@ -0,0 +1,124 @@
+#include "render/meshlets.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace render
+{
+	namespace
+	{
+		void compute_bounds(meshlet& m, const std::vector<uint32_t>& indices, const std::vector<vertex_data>& vertices)
+		{
+			glm::vec3 min(std::numeric_limits<float>::max());
+			glm::vec3 max(std::numeric_limits<float>::lowest());
+			glm::vec3 axis(0.0f);
+			for(uint32_t i=m.firstIndex; i<m.firstIndex+m.triangleCount*3; i++)
+			{
+				min = glm::min(min, vertices[indices[i]].position);
+				max = glm::max(max, vertices[indices[i]].position);
+			}
+			m.center = (min + max) * 0.5f;
+			m.radius = 0.0f;
+			for(uint32_t i=m.firstIndex; i<m.firstIndex+m.triangleCount*3; i++)
+				m.radius = std::max(m.radius, glm::distance(m.center, vertices[indices[i]].position));
+
+			auto triangle_normal = [&](uint32_t t){
+				glm::vec3 p0 = vertices[indices[m.firstIndex+t*3+0]].position;
+				glm::vec3 p1 = vertices[indices[m.firstIndex+t*3+1]].position;
+				glm::vec3 p2 = vertices[indices[m.firstIndex+t*3+2]].position;
+				glm::vec3 n = glm::cross(p1-p0, p2-p0);
+				float length = glm::length(n);
+				return length > 0.0f ? n / length : glm::vec3(0.0f);
+			};
+			for(uint32_t t=0; t<m.triangleCount; t++)
+				axis += triangle_normal(t);
+
+			m.coneAxis = glm::vec3(0.0f);
+			m.coneCutoff = 1.0f;
+			float length = glm::length(axis);
+			if(length == 0.0f)
+				return;
+			axis = axis / length;
+
+			float minDot = 1.0f;
+			for(uint32_t t=0; t<m.triangleCount; t++)
+				minDot = std::min(minDot, glm::dot(triangle_normal(t), axis));
+
+			// a cone that is (almost) a half space would never cull anything
+			if(minDot <= 0.1f)
+				return;
+			m.coneAxis = axis;
+			m.coneCutoff = std::sqrt(1.0f - minDot*minDot);
+		}
+
+		void build_range(const std::vector<uint32_t>& indices, const std::vector<vertex_data>& vertices,
+			size_t firstTriangle, size_t lastTriangle, std::vector<meshlet>& meshlets)
+		{
+			// sorted vertices of the current meshlet, small enough for a binary search to beat a hash set
+			std::vector<uint32_t> used;
+			used.reserve(meshlet::maxVertices+3);
+
+			auto is_new = [&](uint32_t v){
+				auto it = std::lower_bound(used.begin(), used.end(), v);
+				return it == used.end() || *it != v;
+			};
+			auto add = [&](uint32_t v){
+				auto it = std::lower_bound(used.begin(), used.end(), v);
+				if(it == used.end() || *it != v)
+					used.insert(it, v);
+			};
+
+			meshlet current{};
+			current.firstIndex = firstTriangle*3;
+			for(size_t t=firstTriangle; t<lastTriangle; t++)
+			{
+				uint32_t a = indices[t*3+0], b = indices[t*3+1], c = indices[t*3+2];
+				uint32_t extra = is_new(a) + (is_new(b) && b != a) + (is_new(c) && c != a && c != b);
+				if(current.triangleCount == meshlet::maxTriangles || used.size() + extra > meshlet::maxVertices)
+				{
+					current.vertexCount = used.size();
+					meshlets.push_back(current);
+					current = meshlet{};
+					current.firstIndex = t*3;
+					used.clear();
+				}
+				add(a);
+				add(b);
+				add(c);
+				current.triangleCount++;
+			}
+			if(current.triangleCount > 0)
+			{
+				current.vertexCount = used.size();
+				meshlets.push_back(current);
+			}
+
+			for(meshlet& m : meshlets)
+				compute_bounds(m, indices, vertices);
+		}
+	}
+
+	std::vector<meshlet> build_meshlets(const std::vector<uint32_t>& indices, const std::vector<vertex_data>& vertices, unsigned int threads)
+	{
+		size_t triangleCount = indices.size()/3;
+		// every thread should get at least a few hundred meshlets worth of triangles
+		threads = std::clamp<size_t>(triangleCount / (meshlet::maxTriangles*256), 1, std::max(threads, 1u));
+
+		std::vector<std::vector<meshlet>> ranges(threads);
+		std::vector<std::thread> workers;
+		for(unsigned int i=1; i<threads; i++)
+		{
+			workers.emplace_back(build_range, std::cref(indices), std::cref(vertices),
+				triangleCount*i/threads, triangleCount*(i+1)/threads, std::ref(ranges[i]));
+		}
+		build_range(indices, vertices, 0, triangleCount/threads, ranges[0]);
+		for(auto& w : workers)
+			w.join();
+
+		std::vector<meshlet> meshlets;
+		for(auto& r : ranges)
+			meshlets.insert(meshlets.end(), r.begin(), r.end());
+		return meshlets;
+	}
+}
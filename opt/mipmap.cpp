@@ -0,0 +1,99 @@
+#include "render/mipmap.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace render
+{
+	namespace
+	{
+		struct srgb_tables
+		{
+			std::array<float, 256> toLinear;
+			std::array<uint8_t, 4096> fromLinear;
+
+			srgb_tables()
+			{
+				for(int i=0; i<256; i++)
+				{
+					float c = i / 255.0f;
+					toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+				}
+				for(int i=0; i<4096; i++)
+				{
+					float l = i / 4095.0f;
+					float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+					fromLinear[i] = static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+				}
+			}
+		};
+
+		// one row of the next level from two rows of the current one, odd sizes drop their last row and column
+		void downsample_row(const uint8_t* row0, const uint8_t* row1, uint32_t step, uint8_t* dst, uint32_t width)
+		{
+			for(uint32_t x=0; x<width; x++)
+			{
+				for(uint32_t c=0; c<4; c++)
+				{
+					uint32_t sum = row0[x*8+c] + row0[x*8+step+c] + row1[x*8+c] + row1[x*8+step+c];
+					dst[x*4+c] = static_cast<uint8_t>((sum + 2) >> 2);
+				}
+			}
+		}
+
+		void downsample_row_srgb(const uint8_t* row0, const uint8_t* row1, uint32_t step, uint8_t* dst, uint32_t width,
+			const srgb_tables& tables)
+		{
+			for(uint32_t x=0; x<width; x++)
+			{
+				for(uint32_t c=0; c<3; c++)
+				{
+					float sum = tables.toLinear[row0[x*8+c]] + tables.toLinear[row0[x*8+step+c]] +
+						tables.toLinear[row1[x*8+c]] + tables.toLinear[row1[x*8+step+c]];
+					dst[x*4+c] = tables.fromLinear[static_cast<uint32_t>(sum * (4095.0f / 4.0f) + 0.5f)];
+				}
+				uint32_t alpha = row0[x*8+3] + row0[x*8+step+3] + row1[x*8+3] + row1[x*8+step+3];
+				dst[x*4+3] = static_cast<uint8_t>((alpha + 2) >> 2);
+			}
+		}
+	}
+
+	void generate_mips(std::vector<uint8_t>& pixels, uint32_t width, uint32_t height, uint32_t mipLevels, bool srgb)
+	{
+		static const srgb_tables tables;
+
+		size_t size = size_t(width) * height * 4;
+		size_t total = 0;
+		for(uint32_t level=0, w=width, h=height; level<mipLevels; level++, w=std::max(w/2, 1u), h=std::max(h/2, 1u))
+			total += size_t(w) * h * 4;
+		pixels.resize(total);
+
+		size_t offset = 0;
+		for(uint32_t level=1; level<mipLevels; level++)
+		{
+			uint32_t w = std::max(width/2, 1u);
+			uint32_t h = std::max(height/2, 1u);
+			const uint8_t* src = pixels.data() + offset;
+			uint8_t* dst = pixels.data() + offset + size;
+
+			// a side of length 1 averages its only texel with itself
+			uint32_t step = width > 1 ? 4 : 0;
+			size_t pitch = size_t(width) * 4;
+			for(uint32_t y=0; y<h; y++)
+			{
+				const uint8_t* row0 = src + 2*y * pitch;
+				const uint8_t* row1 = height > 1 ? row0 + pitch : row0;
+				if(srgb)
+					downsample_row_srgb(row0, row1, step, dst + size_t(y) * w * 4, w, tables);
+				else
+					downsample_row(row0, row1, step, dst + size_t(y) * w * 4, w);
+			}
+
+			offset += size;
+			size = size_t(w) * h * 4;
+			width = w;
+			height = h;
+		}
+	}
+}
@@ -1,78 +1,493 @@
 #include "render/obj_loader.hpp"
 
-#include <sstream>
 #include <array>
-#include <tuple>
+#include <bit>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iterator>
+#include <thread>
 
 namespace render
 {
-	void load_obj(std::istream &in, std::vector<vertex_data> &vertices, std::vector<uint32_t> &indices)
+	namespace
 	{
-		std::vector<glm::vec3> positions;
-		std::vector<glm::vec3> normals;
-		std::vector<glm::vec2> texCoords;
-		std::vector<std::tuple<int, int, int>> cindices;
-
-		std::string line;
-		while(std::getline(in, line))
-		{
-			std::istringstream is(line);
-			std::string type;
-			is >> type;
-			if(type=="v")
+		struct index_triple
+		{
+			uint32_t position;
+			uint32_t texCoord;
+			uint32_t normal;
+
+			bool operator==(const index_triple&) const = default;
+		};
+
+		size_t hash(index_triple key)
+		{
+			uint64_t h = key.position * 0x9E3779B97F4A7C15ull;
+			h ^= key.texCoord * 0xC2B2AE3D27D4EB4Full;
+			h ^= key.normal * 0x165667B19E3779F9ull;
+			return h ^ (h >> 29);
+		}
+
+		// Open addressing with linear probing. Keys are stored inline with the vertex index,
+		// so a lookup usually touches a single cache line.
+		class vertex_map
+		{
+			public:
+				vertex_map(size_t expected)
+				{
+					slots.resize(std::bit_ceil(std::max<size_t>(expected*2, 64)));
+				}
+
+				// returns the vertex index for the triple and whether it has just been inserted
+				std::pair<uint32_t, bool> insert(index_triple key, uint32_t vertex)
+				{
+					if((count+1)*2 > slots.size())
+						grow();
+
+					size_t mask = slots.size()-1;
+					for(size_t i = hash(key) & mask;; i = (i+1) & mask)
+					{
+						slot& s = slots[i];
+						if(s.vertex == empty)
+						{
+							s = {key, vertex};
+							count++;
+							return {vertex, true};
+						}
+						if(s.key == key)
+							return {s.vertex, false};
+					}
+				}
+
+				// returns UINT32_MAX if the triple has never been inserted
+				uint32_t find(index_triple key) const
+				{
+					size_t mask = slots.size()-1;
+					for(size_t i = hash(key) & mask;; i = (i+1) & mask)
+					{
+						const slot& s = slots[i];
+						if(s.vertex == empty || s.key == key)
+							return s.vertex;
+					}
+				}
+
+				size_t size() const { return count; }
+			private:
+				struct slot
+				{
+					index_triple key;
+					uint32_t vertex = empty;
+				};
+				static constexpr uint32_t empty = UINT32_MAX;
+
+				std::vector<slot> slots;
+				size_t count = 0;
+
+				void grow()
+				{
+					std::vector<slot> old(slots.size()*2);
+					std::swap(old, slots);
+
+					size_t mask = slots.size()-1;
+					for(const slot& s : old)
+					{
+						if(s.vertex == empty)
+							continue;
+						size_t i = hash(s.key) & mask;
+						while(slots[i].vertex != empty)
+							i = (i+1) & mask;
+						slots[i] = s;
+					}
+				}
+		};
+	}
+
+	namespace
+	{
+		struct obj_data
+		{
+			std::vector<glm::vec3> positions;
+			std::vector<glm::vec3> normals;
+			std::vector<glm::vec2> texCoords;
+			std::vector<index_triple> triples;
+		};
+
+		bool is_space(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\r';
+		}
+
+		const char* skip_spaces(const char* p, const char* end)
+		{
+			while(p < end && is_space(*p))
+				p++;
+			return p;
+		}
+
+		const char* parse_float(const char* p, const char* end, float& value)
+		{
+			p = skip_spaces(p, end);
+			if(p < end && *p == '+')
+				p++;
+			value = 0.0f;
+			return std::from_chars(p, end, value).ptr;
+		}
+
+		// OBJ indices are 1-based, a missing index ends up as UINT32_MAX
+		const char* parse_index(const char* p, const char* end, uint32_t& index)
+		{
+			int value = 0;
+			p = std::from_chars(p, end, value).ptr;
+			index = static_cast<uint32_t>(value-1);
+			return p;
+		}
+
+		const char* parse_face_vertex(const char* p, const char* end, index_triple& triple)
+		{
+			triple = {UINT32_MAX, UINT32_MAX, UINT32_MAX};
+			p = parse_index(skip_spaces(p, end), end, triple.position);
+			if(p < end && *p == '/')
 			{
-				float x, y, z;
-				is >> x >> y >> z;
-				positions.push_back({x, y, z});
+				p++;
+				if(p < end && *p != '/')
+					p = parse_index(p, end, triple.texCoord);
+				if(p < end && *p == '/')
+					p = parse_index(p+1, end, triple.normal);
 			}
-			if(type=="vt")
+			return p;
+		}
+
+		// true if the line starts with the given keyword followed by whitespace
+		bool keyword(const char* p, const char* end, std::string_view word)
+		{
+			return static_cast<size_t>(end - p) > word.size() && std::equal(word.begin(), word.end(), p) && is_space(p[word.size()]);
+		}
+
+		// Passes every face vertex to face, attributes are skipped without an obj to store them in
+		template<typename F>
+		void parse_line(const char* p, const char* end, obj_data* obj, F& face)
+		{
+			p = skip_spaces(p, end);
+			if(keyword(p, end, "f"))
+			{
+				p++;
+				for(int i=0; i<3; i++)
+				{
+					index_triple triple;
+					p = parse_face_vertex(p, end, triple);
+					face(triple);
+				}
+			}
+			else if(!obj)
+			{
+				return;
+			}
+			else if(keyword(p, end, "v"))
+			{
+				glm::vec3& v = obj->positions.emplace_back();
+				p = parse_float(p+1, end, v.x);
+				p = parse_float(p, end, v.y);
+				p = parse_float(p, end, v.z);
+			}
+			else if(keyword(p, end, "vt"))
 			{
 				float u, v;
-				is >> u >> v;
-				texCoords.push_back({u, -v});
+				p = parse_float(p+2, end, u);
+				p = parse_float(p, end, v);
+				obj->texCoords.push_back({u, -v});
 			}
-			if(type=="vn")
+			else if(keyword(p, end, "vn"))
 			{
-				float x, y, z;
-				is >> x >> y >> z;
-				normals.push_back({x, y, z});
+				glm::vec3& n = obj->normals.emplace_back();
+				p = parse_float(p+2, end, n.x);
+				p = parse_float(p, end, n.y);
+				p = parse_float(p, end, n.z);
 			}
-			if(type=="f")
+		}
+
+		template<typename F>
+		void parse_obj(const char* p, const char* end, obj_data* obj, F&& face)
+		{
+			while(p < end)
 			{
-				std::array<std::string, 3> args;
-				is >> args[0] >> args[1] >> args[2];
-				for(int i=0; i<3; i++)
-				{
-					std::stringstream s(args[i]);
-					int vertex, uv, normal;
+				const char* eol = static_cast<const char*>(std::memchr(p, '\n', end-p));
+				if(!eol)
+					eol = end;
+				parse_line(p, eol, obj, face);
+				p = eol+1;
+			}
+		}
+
+		void parse_obj(const char* p, const char* end, obj_data& obj)
+		{
+			parse_obj(p, end, &obj, [&obj](index_triple triple){
+				obj.triples.push_back(triple);
+			});
+		}
 
-					s >> vertex;
-					s.ignore(1);
-					s >> uv;
-					s.ignore(1);
-					s >> normal;
+		template<typename T>
+		T attribute(const std::vector<T>& values, uint32_t index)
+		{
+			return index < values.size() ? values[index] : T{};
+		}
+
+		void build_vertices(const obj_data& obj, std::vector<vertex_data>& vertices, std::vector<uint32_t>& indices)
+		{
+			// most meshes have about one unique vertex per position (or per normal/uv on hard edges)
+			size_t expectedVertices = std::min(obj.triples.size(), std::max({obj.positions.size(), obj.normals.size(), obj.texCoords.size()}));
+			vertices.reserve(vertices.size() + expectedVertices);
+			indices.reserve(indices.size() + obj.triples.size());
 
-					cindices.push_back({vertex-1, uv-1, normal-1});
+			uint32_t base = vertices.size();
+			vertex_map map(expectedVertices);
+			for(const index_triple& index : obj.triples)
+			{
+				auto [vertex, inserted] = map.insert(index, vertices.size() - base);
+				if(inserted)
+				{
+					vertices.push_back({attribute(obj.positions, index.position),
+						attribute(obj.normals, index.normal), attribute(obj.texCoords, index.texCoord)});
 				}
+				indices.push_back(base + vertex);
 			}
 		}
+	}
+
+	namespace
+	{
+		// below this many bytes per thread, spawning threads costs more than it saves
+		constexpr size_t minChunkSize = 1024*1024;
+
+		template<typename F>
+		void parallel_for(unsigned int count, F&& f)
+		{
+			std::vector<std::thread> threads;
+			threads.reserve(count-1);
+			for(unsigned int i=1; i<count; i++)
+				threads.emplace_back(f, i);
+			f(0);
+			for(auto& t : threads)
+				t.join();
+		}
+
+		std::pair<size_t, size_t> split_range(size_t size, unsigned int parts, unsigned int part)
+		{
+			return {size*part/parts, size*(part+1)/parts};
+		}
+
+		// splits the text into roughly equal chunks that start at the beginning of a line
+		std::vector<const char*> split_lines(const char* begin, const char* end, unsigned int parts)
+		{
+			std::vector<const char*> bounds(parts+1);
+			bounds[0] = begin;
+			for(unsigned int i=1; i<parts; i++)
+			{
+				const char* p = std::max(begin + split_range(end-begin, parts, i).first, bounds[i-1]);
+				const char* eol = static_cast<const char*>(std::memchr(p, '\n', end-p));
+				bounds[i] = eol ? eol+1 : end;
+			}
+			bounds[parts] = end;
+			return bounds;
+		}
+
+		template<typename T>
+		void append_chunks(std::vector<obj_data>& chunks, std::vector<T> obj_data::* member, obj_data& obj, unsigned int threads)
+		{
+			std::vector<size_t> offsets(chunks.size()+1);
+			for(size_t i=0; i<chunks.size(); i++)
+				offsets[i+1] = offsets[i] + (chunks[i].*member).size();
+
+			(obj.*member).resize(offsets.back());
+			parallel_for(threads, [&](unsigned int i){
+				std::vector<T>& chunk = chunks[i].*member;
+				std::copy(chunk.begin(), chunk.end(), (obj.*member).begin() + offsets[i]);
+				std::vector<T>().swap(chunk);
+			});
+		}
+
+		// Face indices in OBJ are absolute, so concatenating the per-chunk arrays
+		// at their prefix-summed offsets keeps all references valid.
+		obj_data merge_chunks(std::vector<obj_data>& chunks, unsigned int threads)
+		{
+			obj_data obj;
+			append_chunks(chunks, &obj_data::positions, obj, threads);
+			append_chunks(chunks, &obj_data::normals, obj, threads);
+			append_chunks(chunks, &obj_data::texCoords, obj, threads);
+			append_chunks(chunks, &obj_data::triples, obj, threads);
+			return obj;
+		}
+
+		// Same result as build_vertices (vertices numbered in order of first appearance), but the
+		// triples are sharded by hash so every thread deduplicates its own disjoint set of keys.
+		void build_vertices_parallel(const obj_data& obj, std::vector<vertex_data>& vertices, std::vector<uint32_t>& indices, unsigned int threads)
+		{
+			const size_t count = obj.triples.size();
+			const unsigned int shards = threads;
+			auto shard_of = [shards](index_triple key) {
+				return static_cast<unsigned int>(((hash(key) >> 32) * shards) >> 32);
+			};
+
+			// 1. bucket triples by shard, keeping them in file order inside each bucket
+			std::vector<std::vector<std::vector<uint32_t>>> buckets(threads, std::vector<std::vector<uint32_t>>(shards));
+			parallel_for(threads, [&](unsigned int r){
+				auto [begin, end] = split_range(count, threads, r);
+				for(auto& b : buckets[r])
+					b.reserve((end-begin)/shards + 16);
+				for(size_t i=begin; i<end; i++)
+					buckets[r][shard_of(obj.triples[i])].push_back(i);
+			});
+
+			// 2. deduplicate each shard, assigning shard-local vertex ids
+			std::vector<uint32_t> local(count);
+			std::vector<uint8_t> first(count);
+			std::vector<std::vector<uint32_t>> shardVertices(shards);
+			parallel_for(shards, [&](unsigned int s){
+				size_t shardSize = 0;
+				for(unsigned int r=0; r<threads; r++)
+					shardSize += buckets[r][s].size();
+
+				vertex_map map(shardSize/3);
+				uint32_t unique = 0;
+				for(unsigned int r=0; r<threads; r++)
+				{
+					for(uint32_t i : buckets[r][s])
+					{
+						auto [vertex, inserted] = map.insert(obj.triples[i], unique);
+						unique += inserted;
+						local[i] = vertex;
+						first[i] = inserted;
+					}
+					std::vector<uint32_t>().swap(buckets[r][s]);
+				}
+				shardVertices[s].resize(unique);
+			});
+
+			// 3. number the first appearances globally with a prefix sum over the ranges
+			std::vector<size_t> rangeOffsets(threads+1);
+			parallel_for(threads, [&](unsigned int r){
+				auto [begin, end] = split_range(count, threads, r);
+				rangeOffsets[r+1] = std::count(first.begin()+begin, first.begin()+end, 1);
+			});
+			for(unsigned int r=0; r<threads; r++)
+				rangeOffsets[r+1] += rangeOffsets[r];
+
+			uint32_t base = vertices.size();
+			vertices.resize(base + rangeOffsets.back());
+			parallel_for(threads, [&](unsigned int r){
+				auto [begin, end] = split_range(count, threads, r);
+				uint32_t vertex = base + rangeOffsets[r];
+				for(size_t i=begin; i<end; i++)
+				{
+					if(!first[i])
+						continue;
+					const index_triple& index = obj.triples[i];
+					shardVertices[shard_of(index)][local[i]] = vertex;
+					vertices[vertex++] = {attribute(obj.positions, index.position),
+						attribute(obj.normals, index.normal), attribute(obj.texCoords, index.texCoord)};
+				}
+			});
+
+			// 4. resolve every triple to its global vertex
+			size_t indexBase = indices.size();
+			indices.resize(indexBase + count);
+			parallel_for(threads, [&](unsigned int r){
+				auto [begin, end] = split_range(count, threads, r);
+				for(size_t i=begin; i<end; i++)
+					indices[indexBase + i] = shardVertices[shard_of(obj.triples[i])][local[i]];
+			});
+		}
+	}
 
-		std::vector<std::tuple<int, int, int>> indexCombos;
-		for(int i=0; i<cindices.size(); i++)
+	void load_obj(std::string_view data, std::vector<vertex_data>& vertices, std::vector<uint32_t>& indices, unsigned int threads)
+	{
+		const char* begin = data.data();
+		const char* end = data.data()+data.size();
+
+		threads = std::clamp<size_t>(data.size()/minChunkSize, 1, std::max(threads, 1u));
+		if(threads == 1)
 		{
-			auto index = cindices[i];
-			auto p = std::find(indexCombos.begin(), indexCombos.end(), index);
-			if(p == indexCombos.end())
+			obj_data obj;
+			parse_obj(begin, end, obj);
+			build_vertices(obj, vertices, indices);
+			return;
+		}
+
+		std::vector<const char*> bounds = split_lines(begin, end, threads);
+		std::vector<obj_data> chunks(threads);
+		parallel_for(threads, [&](unsigned int i){
+			parse_obj(bounds[i], bounds[i+1], chunks[i]);
+		});
+
+		obj_data obj = merge_chunks(chunks, threads);
+		build_vertices_parallel(obj, vertices, indices, threads);
+	}
+
+	struct obj_stream::state
+	{
+		std::string_view data;
+		obj_data obj;
+		vertex_map map{0};
+		size_t indexCount = 0;
+		glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+	};
+
+	obj_stream::obj_stream(std::string_view data) : s(std::make_unique<state>())
+	{
+		s->data = data;
+		parse_obj(data.data(), data.data()+data.size(), &s->obj, [this](index_triple triple){
+			auto [vertex, inserted] = s->map.insert(triple, s->map.size());
+			if(inserted)
+			{
+				glm::vec3 position = attribute(s->obj.positions, triple.position);
+				s->min = glm::min(s->min, position);
+				s->max = glm::max(s->max, position);
+			}
+			s->indexCount++;
+		});
+	}
+
+	obj_stream::~obj_stream() = default;
+
+	size_t obj_stream::vertexCount() const { return s->map.size(); }
+	size_t obj_stream::indexCount() const { return s->indexCount; }
+	glm::vec3 obj_stream::min() const { return s->min; }
+	glm::vec3 obj_stream::max() const { return s->max; }
+
+	void obj_stream::emit(const batch_function& batch, size_t batchSize) const
+	{
+		std::vector<vertex_data> vertices;
+		std::vector<uint32_t> indices;
+		vertices.reserve(batchSize);
+		indices.reserve(batchSize);
+
+		// vertices were numbered in order of first appearance, so a vertex is new exactly when it is the next number
+		uint32_t next = 0;
+		parse_obj(s->data.data(), s->data.data()+s->data.size(), nullptr, [&](index_triple triple){
+			uint32_t vertex = s->map.find(triple);
+			if(vertex == next)
 			{
-				indices.push_back(vertices.size());
-				auto [pos, tex, nor] = index;
-				vertices.push_back({positions[pos], normals[nor], texCoords[tex]});
-				indexCombos.push_back(index);
+				vertices.push_back({attribute(s->obj.positions, triple.position),
+					attribute(s->obj.normals, triple.normal), attribute(s->obj.texCoords, triple.texCoord)});
+				next++;
 			}
-			else
+			indices.push_back(vertex);
+
+			if(vertices.size() == batchSize || indices.size() == batchSize)
 			{
-				indices.push_back(std::distance(indexCombos.begin(), p));
+				batch(vertices, indices);
+				vertices.clear();
+				indices.clear();
 			}
-		}
+		});
+		if(!vertices.empty() || !indices.empty())
+			batch(vertices, indices);
+	}
+
+	void load_obj(std::istream &in, std::vector<vertex_data> &vertices, std::vector<uint32_t> &indices)
+	{
+		std::string data(std::istreambuf_iterator<char>(in), {});
+		load_obj(std::string_view(data), vertices, indices);
 	}
-}
\ No newline at end of file
+}
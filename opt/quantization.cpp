@@ -0,0 +1,94 @@
+#include "render/quantization.hpp"
+
+#include <bit>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+
+namespace render
+{
+	uint16_t float_to_half(float value)
+	{
+		uint32_t bits = std::bit_cast<uint32_t>(value);
+		uint32_t sign = (bits >> 16) & 0x8000;
+		uint32_t magnitude = bits & 0x7FFFFFFF;
+
+		if(magnitude >= 0x7F800000) // Inf and NaN
+			return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+		if(magnitude >= 0x477FF000) // rounds to a value above the largest half
+			return sign | 0x7C00;
+		if(magnitude < 0x38800000) // denormal (or zero) as a half
+		{
+			float denormal = std::bit_cast<float>(magnitude) * 16777216.0f; // scale by 2^24, half denormals are multiples of 2^-24
+			return sign | static_cast<uint32_t>(std::nearbyint(denormal));
+		}
+
+		// rebias the exponent and round the mantissa to nearest even
+		uint32_t half = (magnitude - 0x38000000) >> 13;
+		uint32_t rest = magnitude & 0x1FFF;
+		if(rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+			half++;
+		return sign | half;
+	}
+
+	std::array<int8_t, 2> encode_octahedral(glm::vec3 n)
+	{
+		float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+		if(sum == 0.0f)
+			return {0, 0};
+
+		float x = n.x / sum;
+		float y = n.y / sum;
+		if(n.z < 0.0f)
+		{
+			float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = fx;
+			y = fy;
+		}
+		return {
+			static_cast<int8_t>(std::lround(std::clamp(x, -1.0f, 1.0f) * 127.0f)),
+			static_cast<int8_t>(std::lround(std::clamp(y, -1.0f, 1.0f) * 127.0f))
+		};
+	}
+
+	void quantize_vertices(std::span<const vertex_data> vertices, glm::vec3 min, glm::vec3 max, packed_vertex_data* packed)
+	{
+		glm::vec3 extent = max - min;
+		glm::vec3 scale(0.0f);
+		for(int i=0; i<3; i++)
+			scale[i] = extent[i] > 0.0f ? 65535.0f / extent[i] : 0.0f;
+
+		for(size_t i=0; i<vertices.size(); i++)
+		{
+			const vertex_data& v = vertices[i];
+			packed_vertex_data& p = packed[i];
+
+			glm::vec3 position = (v.position - min) * scale;
+			for(int k=0; k<3; k++)
+				p.position[k] = static_cast<uint16_t>(std::clamp(position[k] + 0.5f, 0.0f, 65535.0f));
+			p.position[3] = 65535;
+			p.normal = encode_octahedral(v.normal);
+			p.padding = {0, 0};
+			p.texCoord = {float_to_half(v.texCoord.x), float_to_half(v.texCoord.y)};
+		}
+	}
+
+	void quantize_vertices(const std::vector<vertex_data>& vertices, glm::vec3 min, glm::vec3 max, std::vector<packed_vertex_data>& packed)
+	{
+		packed.resize(vertices.size());
+		quantize_vertices(std::span(vertices), min, max, packed.data());
+	}
+
+	std::span<const std::byte> narrow_indices(std::vector<uint32_t>& indices)
+	{
+		// index i is written to bytes [2i, 2i+2), which never overlaps indices that are still to be read
+		std::byte* data = reinterpret_cast<std::byte*>(indices.data());
+		for(size_t i=0; i<indices.size(); i++)
+		{
+			uint16_t index = static_cast<uint16_t>(indices[i]);
+			std::memcpy(data + i*sizeof(uint16_t), &index, sizeof(index));
+		}
+		return std::span<const std::byte>(data, indices.size() * sizeof(uint16_t));
+	}
+}
@@ -0,0 +1,308 @@
+#include "render/simplifier.hpp"
+#include "render/mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+
+namespace render
+{
+	namespace
+	{
+		// symmetric 4x4 matrix summing the squared distances to a set of planes
+		struct quadric
+		{
+			double a2 = 0, ab = 0, ac = 0, ad = 0;
+			double b2 = 0, bc = 0, bd = 0;
+			double c2 = 0, cd = 0;
+			double d2 = 0;
+			double weight = 0;
+
+			static quadric plane(glm::vec3 n, float d, double w)
+			{
+				quadric q;
+				q.a2 = w*n.x*n.x; q.ab = w*n.x*n.y; q.ac = w*n.x*n.z; q.ad = w*n.x*d;
+				q.b2 = w*n.y*n.y; q.bc = w*n.y*n.z; q.bd = w*n.y*d;
+				q.c2 = w*n.z*n.z; q.cd = w*n.z*d;
+				q.d2 = w*d*d;
+				q.weight = w;
+				return q;
+			}
+
+			quadric& operator+=(const quadric& o)
+			{
+				a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+				b2 += o.b2; bc += o.bc; bd += o.bd;
+				c2 += o.c2; cd += o.cd;
+				d2 += o.d2;
+				weight += o.weight;
+				return *this;
+			}
+
+			double evaluate(glm::vec3 p) const
+			{
+				double x = p.x, y = p.y, z = p.z;
+				return a2*x*x + 2*ab*x*y + 2*ac*x*z + 2*ad*x
+					+ b2*y*y + 2*bc*y*z + 2*bd*y
+					+ c2*z*z + 2*cd*z
+					+ d2;
+			}
+		};
+
+		struct position_hash
+		{
+			size_t operator()(const glm::vec3& p) const
+			{
+				uint64_t h = std::bit_cast<uint32_t>(p.x);
+				h = h * 0x9e3779b97f4a7c15ull ^ std::bit_cast<uint32_t>(p.y);
+				h = h * 0x9e3779b97f4a7c15ull ^ std::bit_cast<uint32_t>(p.z);
+				return h ^ (h >> 29);
+			}
+		};
+
+		struct collapse
+		{
+			uint32_t from;
+			uint32_t to;
+			double cost;
+		};
+
+		glm::vec3 triangle_normal(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2)
+		{
+			return glm::cross(p1-p0, p2-p0);
+		}
+
+		// quadrics are per position and only built from indices when empty. Passing them on to the next call keeps
+		// measuring errors against the mesh they were built from instead of the already simplified one.
+		float simplify(std::vector<uint32_t>& indices, const std::vector<vertex_data>& vertices, size_t targetIndexCount,
+			std::vector<quadric>& quadrics)
+		{
+			size_t vertexCount = vertices.size();
+
+			// vertices that only differ in normal or texture coordinates are one position for the simplifier
+			std::vector<uint32_t> position(vertexCount);
+			std::vector<uint32_t> wedges(vertexCount, 0);
+			{
+				std::unordered_map<glm::vec3, uint32_t, position_hash> unique;
+				unique.reserve(vertexCount);
+				for(uint32_t v=0; v<vertexCount; v++)
+				{
+					position[v] = unique.try_emplace(vertices[v].position, v).first->second;
+					wedges[position[v]]++;
+				}
+			}
+
+			if(quadrics.empty())
+			{
+				quadrics.resize(vertexCount);
+				for(size_t i=0; i<indices.size(); i+=3)
+				{
+					glm::vec3 p0 = vertices[indices[i+0]].position;
+					glm::vec3 n = triangle_normal(p0, vertices[indices[i+1]].position, vertices[indices[i+2]].position);
+					float area = glm::length(n);
+					if(area == 0.0f)
+						continue;
+					n = n / area;
+					quadric q = quadric::plane(n, -glm::dot(n, p0), area*0.5);
+					for(int k=0; k<3; k++)
+						quadrics[position[indices[i+k]]] += q;
+				}
+			}
+
+			// an edge used by only one triangle is on a border, moving its vertices would open up holes
+			std::vector<bool> locked(vertexCount, false);
+			{
+				std::vector<std::pair<uint32_t, uint32_t>> edges;
+				edges.reserve(indices.size());
+				for(size_t i=0; i<indices.size(); i+=3)
+				{
+					for(int k=0; k<3; k++)
+					{
+						uint32_t a = position[indices[i+k]], b = position[indices[i+(k+1)%3]];
+						edges.emplace_back(std::min(a, b), std::max(a, b));
+					}
+				}
+				std::sort(edges.begin(), edges.end());
+				for(size_t i=0; i<edges.size();)
+				{
+					size_t j = i;
+					while(j < edges.size() && edges[j] == edges[i])
+						j++;
+					if(j - i == 1)
+						locked[edges[i].first] = locked[edges[i].second] = true;
+					i = j;
+				}
+			}
+			auto movable = [&](uint32_t v){
+				return !locked[v] && wedges[v] == 1;
+			};
+
+			std::vector<uint32_t> offsets(vertexCount+1);
+			std::vector<uint32_t> adjacent;
+			std::vector<uint32_t> remap(vertexCount);
+			std::vector<bool> touched(vertexCount);
+			std::vector<collapse> candidates;
+			double error = 0.0;
+
+			while(indices.size() > targetIndexCount)
+			{
+				size_t triangleCount = indices.size()/3;
+
+				std::fill(offsets.begin(), offsets.end(), 0);
+				for(uint32_t i : indices)
+					offsets[position[i]+1]++;
+				std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+				adjacent.resize(indices.size());
+				{
+					std::vector<uint32_t> fill(offsets.begin(), offsets.end()-1);
+					for(size_t i=0; i<indices.size(); i++)
+						adjacent[fill[position[indices[i]]]++] = i/3;
+				}
+
+				// interior edges show up once in each direction, so taking a < b visits every edge once
+				candidates.clear();
+				for(size_t i=0; i<indices.size(); i+=3)
+				{
+					for(int k=0; k<3; k++)
+					{
+						uint32_t a = position[indices[i+k]], b = position[indices[i+(k+1)%3]];
+						if(a >= b || (!movable(a) && !movable(b)))
+							continue;
+
+						double weight = std::max(quadrics[a].weight + quadrics[b].weight, 1e-20);
+						double costA = movable(a) ? (quadrics[a].evaluate(vertices[b].position) + quadrics[b].evaluate(vertices[b].position)) / weight : INFINITY;
+						double costB = movable(b) ? (quadrics[a].evaluate(vertices[a].position) + quadrics[b].evaluate(vertices[a].position)) / weight : INFINITY;
+						if(costA <= costB)
+							candidates.push_back({a, b, std::max(costA, 0.0)});
+						else
+							candidates.push_back({b, a, std::max(costB, 0.0)});
+					}
+				}
+				std::sort(candidates.begin(), candidates.end(), [](const collapse& a, const collapse& b){
+					return a.cost < b.cost;
+				});
+
+				std::iota(remap.begin(), remap.end(), 0);
+				std::fill(touched.begin(), touched.end(), false);
+				size_t removable = (indices.size() - targetIndexCount + 2) / 3;
+				size_t removed = 0;
+				for(const collapse& c : candidates)
+				{
+					if(removed >= removable)
+						break;
+					if(touched[c.from] || touched[c.to])
+						continue;
+
+					// reject collapses that would turn a triangle by more than 60 degrees and find the wedge of the target inside the fan
+					glm::vec3 target = vertices[c.to].position;
+					uint32_t targetWedge = UINT32_MAX;
+					size_t shared = 0;
+					bool flips = false;
+					for(uint32_t i=offsets[c.from]; i<offsets[c.from+1] && !flips; i++)
+					{
+						uint32_t t = adjacent[i];
+						int corner = -1;
+						bool containsTarget = false;
+						for(int k=0; k<3; k++)
+						{
+							uint32_t p = position[indices[t*3+k]];
+							if(p == c.from)
+								corner = k;
+							if(p == c.to)
+							{
+								containsTarget = true;
+								targetWedge = indices[t*3+k];
+							}
+						}
+						if(containsTarget)
+						{
+							shared++;
+							continue;
+						}
+
+						glm::vec3 p[3] = {
+							vertices[indices[t*3+0]].position,
+							vertices[indices[t*3+1]].position,
+							vertices[indices[t*3+2]].position
+						};
+						glm::vec3 before = triangle_normal(p[0], p[1], p[2]);
+						p[corner] = target;
+						glm::vec3 after = triangle_normal(p[0], p[1], p[2]);
+						flips = glm::dot(before, after) <= 0.5f * glm::length(before) * glm::length(after);
+					}
+					if(flips || targetWedge == UINT32_MAX)
+						continue;
+
+					// the whole fan changes, so none of its vertices may move again in this pass
+					for(uint32_t i=offsets[c.from]; i<offsets[c.from+1]; i++)
+						for(int k=0; k<3; k++)
+							touched[position[indices[adjacent[i]*3+k]]] = true;
+
+					remap[c.from] = targetWedge;
+					quadrics[c.to] += quadrics[c.from];
+					error = std::max(error, c.cost);
+					removed += shared;
+				}
+				if(removed == 0)
+					break;
+
+				size_t count = 0;
+				for(size_t t=0; t<triangleCount; t++)
+				{
+					uint32_t a = remap[indices[t*3+0]], b = remap[indices[t*3+1]], c = remap[indices[t*3+2]];
+					if(position[a] == position[b] || position[b] == position[c] || position[a] == position[c])
+						continue;
+					indices[count++] = a;
+					indices[count++] = b;
+					indices[count++] = c;
+				}
+				indices.resize(count);
+			}
+			return std::sqrt(error);
+		}
+	}
+
+	float simplify(std::vector<uint32_t>& indices, const std::vector<vertex_data>& vertices, size_t targetIndexCount)
+	{
+		std::vector<quadric> quadrics;
+		return simplify(indices, vertices, targetIndexCount, quadrics);
+	}
+
+	std::vector<model_lod> generate_lods(std::vector<uint32_t>& indices, const std::vector<vertex_data>& vertices,
+		unsigned int lodCount, bool optimize)
+	{
+		std::vector<model_lod> lods = {model_lod{0, static_cast<uint32_t>(indices.size()), 0.0f}};
+
+		glm::vec3 min(std::numeric_limits<float>::max());
+		glm::vec3 max(std::numeric_limits<float>::lowest());
+		for(const vertex_data& v : vertices)
+		{
+			min = glm::min(min, v.position);
+			max = glm::max(max, v.position);
+		}
+		float diagonal = std::max(glm::length(max - min), std::numeric_limits<float>::min());
+
+		// every level is simplified from the previous one, which is a lot cheaper than starting from the full mesh.
+		// The quadrics keep accumulating the planes of the full mesh though, so errors are against the original surface
+		// and do not just add up the small steps between neighbouring levels.
+		std::vector<uint32_t> lod(indices);
+		std::vector<quadric> quadrics;
+		for(unsigned int i=0; i<lodCount; i++)
+		{
+			size_t previous = lod.size();
+			float error = simplify(lod, vertices, previous / 6 * 3, quadrics);
+			// stop once only locked borders and seams are left
+			if(lod.empty() || lod.size() > previous * 9 / 10)
+				break;
+			if(optimize)
+				optimize_vertex_cache(lod, vertices.size());
+
+			lods.push_back(model_lod{static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lod.size()),
+				std::max(error / diagonal, lods.back().error)});
+			indices.insert(indices.end(), lod.begin(), lod.end());
+		}
+		return lods;
+	}
+}
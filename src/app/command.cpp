@@ -7,6 +7,27 @@
 
 namespace app
 {
+	render::model* resource::use_model(render::upload_waits& waits)
+	{
+		return std::any_cast<render::resident<render::model>&>(handle).use(waits);
+	}
+
+	void resource::refresh()
+	{
+		if(type != Model || !valid)
+			return;
+		auto& model = std::any_cast<render::resident<render::model>&>(handle);
+		render::model* m = model.peek();
+		for(auto c : childs)
+			c->valid = m != nullptr;
+		if(m && generation != model.generation())
+		{
+			childs[0]->handle = m->vertexBuffer;
+			childs[1]->handle = m->indexBuffer;
+			generation = model.generation();
+		}
+	}
+
 	command::command(enum command::type type) : type(type)
 	{
 		switch(type)
@@ -20,6 +41,10 @@ namespace app
 				args.push_back(0u); // firstVertex
 				args.push_back(0u); // firstInstance
 				break;
+			case DrawIndexed:
+				args.push_back(&INVALID_MODEL);
+				args.push_back(1u); // instanceCount
+				break;
 			default:
 				break;
 		}
@@ -57,6 +82,8 @@ namespace app
 				oss << std::any_cast<uint32_t>(args[3]);
 				break;
 			case DrawIndexed:
+				oss << std::any_cast<resource*>(args[0])->name << ", ";
+				oss << std::any_cast<uint32_t>(args[1]);
 				break;
 		}
 		oss << ")";
@@ -82,7 +109,12 @@ namespace app
 					std::any_cast<uint32_t>(args[3]));
 			} break;
 			case DrawIndexed: {
-
+				// evicted models are loaded again and skipped until then
+				render::model* model = ctx.waits ? std::any_cast<resource*>(args[0])->use_model(*ctx.waits) : nullptr;
+				if(!model)
+					break;
+				model->bind(commandBuffer);
+				model->draw(commandBuffer, 0, std::any_cast<uint32_t>(args[1]));
 			} break;
 		}
 	}
@@ -105,6 +137,8 @@ namespace app
 			case DrawIndexed: {
 				if(!state.pipeline_bound)
 					return "no pipeline bound";
+				if(!std::any_cast<resource*>(args[0])->valid)
+					return "invalid model";
 			} break;
 		}
 		return std::optional<std::string>();
@@ -144,7 +178,25 @@ namespace app
 				uint32_t firstInstance = std::any_cast<uint32_t>(args[3]);
 				ImGui::InputScalar("firstInstance", ImGuiDataType_U32, &firstInstance);
 				args[3] = firstInstance;
-			}
+			} break;
+			case DrawIndexed: {
+				if(ImGui::BeginCombo("Model", std::any_cast<resource*>(args[0])->name.c_str()))
+				{
+					for(int i=0; i<ctx.resources.size(); i++)
+					{
+						resource* r = ctx.resources[i];
+
+						if(r->type == resource::Model && r->valid)
+							if(ImGui::Selectable(r->name.c_str(), false))
+								args[0] = r;
+					}
+					ImGui::EndCombo();
+				}
+
+				uint32_t instanceCount = std::any_cast<uint32_t>(args[1]);
+				ImGui::InputScalar("instanceCount", ImGuiDataType_U32, &instanceCount);
+				args[1] = instanceCount;
+			} break;
 			default : {}
 		}
 	}
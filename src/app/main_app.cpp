@@ -127,6 +127,9 @@ namespace app
 				if(ImGui::MenuItem("vkDraw")) {
 					commands.push_back(command(command::type::Draw));
 				}
+				if(ImGui::MenuItem("vkDrawIndexed")) {
+					commands.push_back(command(command::type::DrawIndexed));
+				}
 				ImGui::EndMenu();
 			}
 			ImGui::EndMenuBar();
@@ -593,15 +596,7 @@ namespace app
 				auto path = ImGuiFileDialog::Instance()->GetSelection().begin()->second;
 				auto name = ImGuiFileDialog::Instance()->GetCurrentFileName();
 
-				std::shared_ptr<render::model> model = std::make_shared<render::model>(device, allocator);
-				loader->loadModel(model.get(), path).wait();
-
-				vk::Buffer vertexBuffer = model->vertexBuffer;
-				vk::Buffer indexBuffer = model->indexBuffer;
-				auto v = resources.emplace_back(new resource{resource::type::Buffer, name+"-vertex", vertexBuffer, true, true});
-				auto i = resources.emplace_back(new resource{resource::type::Buffer, name+"-index", indexBuffer, true, true});
-				resources.push_back(new resource{resource::type::Model, name, std::move(model), true, false, {v, i}});
-
+				render::spawn(*renderExecutor, import_model(path, name));
 			}
 			ImGuiFileDialog::Instance()->Close();
 		}
@@ -609,10 +604,89 @@ namespace app
 		ImGui::End();
 	}
 
+	render::async_task<> main_phase::import_model(std::string path, std::string name)
+	{
+		// the residency manager may evict it whenever no command draws it, so the buffers are only borrowed by the childs
+		render::resident<render::model> model = residency->loadModel(path, {}, render::Critical);
+		// failed imports are not listed
+		co_await model.loading();
+
+		auto v = resources.emplace_back(new resource{resource::type::Buffer, name+"-vertex", vk::Buffer{}, false, true});
+		auto i = resources.emplace_back(new resource{resource::type::Buffer, name+"-index", vk::Buffer{}, false, true});
+		auto m = resources.emplace_back(new resource{resource::type::Model, name, std::move(model), true, false, {v, i}});
+		m->refresh();
+	}
+
+	void main_phase::window_loader()
+	{
+		ImGui::Begin("Loader");
+
+		const render::loader_metrics& metrics = loader->metrics();
+		ImGui::Text("Waiting: %zu, decoded: %zu, in flight: %zu", metrics.waiting.load(), metrics.decoded.load(), metrics.inFlight.load());
+
+		auto ms = [](std::chrono::nanoseconds time){
+			return std::chrono::duration<double, std::milli>(time).count();
+		};
+		if(ImGui::BeginTable("stages", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		{
+			ImGui::TableSetupColumn("Stage");
+			ImGui::TableSetupColumn("Tasks");
+			ImGui::TableSetupColumn("Mean (ms)");
+			ImGui::TableSetupColumn("p50 (ms)");
+			ImGui::TableSetupColumn("p95 (ms)");
+			ImGui::TableSetupColumn("p99 (ms)");
+			ImGui::TableHeadersRow();
+
+			auto row = [&](const char* name, const render::latency_histogram& h){
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::TextUnformatted(name);
+				ImGui::TableNextColumn(); ImGui::Text("%lu", h.count());
+				ImGui::TableNextColumn(); ImGui::Text("%.2f", ms(h.mean()));
+				ImGui::TableNextColumn(); ImGui::Text("%.2f", ms(h.percentile(0.50)));
+				ImGui::TableNextColumn(); ImGui::Text("%.2f", ms(h.percentile(0.95)));
+				ImGui::TableNextColumn(); ImGui::Text("%.2f", ms(h.percentile(0.99)));
+			};
+			for(int i=0; i<render::LoadStageCount; i++)
+				row(render::stage_name(static_cast<render::LoadStage>(i)), metrics.stages[i]);
+			row("Total", metrics.total);
+			ImGui::EndTable();
+		}
+
+		if(ImGui::BeginTable("threads", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		{
+			ImGui::TableSetupColumn("Thread");
+			ImGui::TableSetupColumn("Tasks");
+			ImGui::TableSetupColumn("MiB");
+			ImGui::TableSetupColumn("MiB/s");
+			ImGui::TableHeadersRow();
+
+			auto rows = [](const char* name, const std::vector<render::thread_metrics>& threads){
+				for(size_t i=0; i<threads.size(); i++)
+				{
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn(); ImGui::Text("%s %zu", name, i);
+					ImGui::TableNextColumn(); ImGui::Text("%lu", threads[i].tasks.load());
+					ImGui::TableNextColumn(); ImGui::Text("%.1f", threads[i].bytes.load() / (1024.0 * 1024.0));
+					ImGui::TableNextColumn(); ImGui::Text("%.1f", threads[i].bytesPerSecond() / (1024.0 * 1024.0));
+				}
+			};
+			rows("Decoder", metrics.decoders);
+			rows("Submitter", metrics.submitters);
+			ImGui::EndTable();
+		}
+
+		ImGui::Text("Resident: %zu (%.1f MiB), memory: %.1f / %.1f MiB", residency->residentCount(),
+			residency->residentBytes() / (1024.0 * 1024.0), residency->usage() / (1024.0 * 1024.0), residency->budget() / (1024.0 * 1024.0));
+		ImGui::Text("Evictions: %lu, reloads: %lu", residency->evictions(), residency->reloads());
+
+		ImGui::End();
+	}
+
 	void main_phase::render_imgui()
 	{
 		window_commands();
 		window_resources();
+		window_loader();
 	}
 
 	void main_phase::render(int frame, vk::Semaphore imageAvailable, vk::Semaphore renderFinished, vk::Fence fence)
@@ -623,7 +697,11 @@ namespace app
 		render_imgui();
 		ImGui::Render();
 
-		command_context ctx = {resources};
+		// evictions and reloads since the last frame
+		for(auto r : resources)
+			r->refresh();
+
+		command_context ctx = {resources, &uploadWaits};
 		bool commandsValid = true;
 		{
 			command_state state = {};
@@ -644,6 +722,8 @@ namespace app
 		vk::UniqueCommandBuffer& commandBuffer = commandBuffers[frame];
 
 		commandBuffer->begin(vk::CommandBufferBeginInfo());
+		// before anything loaded on the transfer queue is used
+		loader->acquire(commandBuffer.get(), uploadWaits);
 
 		vk::ClearValue color(std::array<float, 4>{0.1f, 0.1f, 0.1f, 1.0f});
 		commandBuffer->beginRenderPass(vk::RenderPassBeginInfo(renderPass.get(), framebuffers[frame].get(), 
@@ -666,8 +746,14 @@ namespace app
 		commandBuffer->endRenderPass();
 		commandBuffer->end();
 
-		vk::PipelineStageFlags waitFlags = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-		vk::SubmitInfo submit_info(imageAvailable, waitFlags, commandBuffer.get(), renderFinished);
+		std::vector<vk::Semaphore> waitSemaphores = {imageAvailable};
+		std::vector<vk::PipelineStageFlags> waitFlags = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
+		std::vector<uint64_t> waitValues;
+		bool uploads = !uploadWaits.empty();
+		uploadWaits.append(waitSemaphores, waitValues, waitFlags);
+
+		vk::TimelineSemaphoreSubmitInfo timeline_info(waitValues, {});
+		vk::SubmitInfo submit_info(waitSemaphores, waitFlags, commandBuffer.get(), renderFinished, uploads ? &timeline_info : nullptr);
 		graphicsQueue.submit(submit_info, fence);
 	}
 }
@@ -0,0 +1,39 @@
+#include "render/async.hpp"
+
+#include <spdlog/spdlog.h>
+
+namespace render
+{
+	void frame_executor::post(std::function<void()> work)
+	{
+		std::scoped_lock<std::mutex> l(lock);
+		queue.push_back(std::move(work));
+	}
+
+	void frame_executor::run()
+	{
+		std::vector<std::function<void()>> work;
+		{
+			std::scoped_lock<std::mutex> l(lock);
+			work.swap(queue);
+		}
+		for(auto& w : work)
+			w();
+	}
+
+	void report_detached(std::exception_ptr error)
+	{
+		try
+		{
+			std::rethrow_exception(error);
+		}
+		catch(const std::exception& e)
+		{
+			spdlog::error("Coroutine failed: {}", e.what());
+		}
+		catch(...)
+		{
+			spdlog::error("Coroutine failed with an unknown exception");
+		}
+	}
+}
@@ -129,7 +129,7 @@ namespace render
 				if(ch >= charEnd)
 					break;
 			}
-		});
+		}, Critical);
 
 		vk::SamplerCreateInfo sampler_info({}, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear,
 			vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat,
@@ -245,9 +245,9 @@ namespace render
 		vertexOffsets.resize(imageCount);
 	}
 
-	void font_renderer::renderText(vk::CommandBuffer cmd, int frame, std::string text, float x, float y, float scale, glm::vec4 color)
+	void font_renderer::renderText(vk::CommandBuffer cmd, upload_waits& waits, int frame, std::string text, float x, float y, float scale, glm::vec4 color)
 	{
-		if(!utils::is_ready(textureReady))
+		if(!waits.use(textureReady))
 			return;
 
 		{
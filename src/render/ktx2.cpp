@@ -0,0 +1,243 @@
+#include "render/ktx2.hpp"
+#include "render/bc_encoder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace render
+{
+	namespace
+	{
+		constexpr std::array<uint8_t, 12> identifier = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+		struct ktx2_header
+		{
+			std::array<uint8_t, 12> identifier;
+			uint32_t vkFormat;
+			uint32_t typeSize;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t layerCount;
+			uint32_t faceCount;
+			uint32_t levelCount;
+			uint32_t supercompressionScheme;
+
+			uint32_t dfdByteOffset;
+			uint32_t dfdByteLength;
+			uint32_t kvdByteOffset;
+			uint32_t kvdByteLength;
+			uint64_t sgdByteOffset;
+			uint64_t sgdByteLength;
+		};
+		static_assert(sizeof(ktx2_header) == 80);
+
+		struct ktx2_level
+		{
+			uint64_t byteOffset;
+			uint64_t byteLength;
+			uint64_t uncompressedByteLength;
+		};
+
+		// Khronos data format descriptor of a BC format, one sample per 64 bit half of a block
+		std::vector<uint32_t> data_format_descriptor(vk::Format format)
+		{
+			struct sample { uint32_t channel; uint32_t offset; uint32_t length; };
+			uint32_t model;
+			std::vector<sample> samples;
+			bool srgb = false;
+			switch(format)
+			{
+				case vk::Format::eBc1RgbSrgbBlock:
+				case vk::Format::eBc1RgbaSrgbBlock:
+					srgb = true;
+					[[fallthrough]];
+				case vk::Format::eBc1RgbUnormBlock:
+				case vk::Format::eBc1RgbaUnormBlock:
+					model = 128;
+					samples = {{0, 0, 64}};
+					break;
+				case vk::Format::eBc3SrgbBlock:
+					srgb = true;
+					[[fallthrough]];
+				case vk::Format::eBc3UnormBlock:
+					model = 130;
+					samples = {{15, 0, 64}, {0, 64, 64}};
+					break;
+				case vk::Format::eBc5UnormBlock:
+				case vk::Format::eBc5SnormBlock:
+					model = 132;
+					samples = {{0, 0, 64}, {1, 64, 64}};
+					break;
+				case vk::Format::eBc7SrgbBlock:
+					srgb = true;
+					[[fallthrough]];
+				case vk::Format::eBc7UnormBlock:
+					model = 134;
+					samples = {{0, 0, 128}};
+					break;
+				default:
+					throw std::runtime_error("no data format descriptor for "+vk::to_string(format));
+			}
+
+			uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+			std::vector<uint32_t> dfd = {
+				4 + blockSize,
+				0, // vendor Khronos, basic descriptor
+				2 | blockSize << 16,
+				model | 1 << 8 | (srgb ? 2u : 1u) << 16, // BT.709 primaries, sRGB or linear transfer
+				3 | 3 << 8, // 4x4 texel blocks
+				static_cast<uint32_t>(block_size(format)),
+				0
+			};
+			for(const sample& s : samples)
+			{
+				dfd.insert(dfd.end(), {s.offset | (s.length-1) << 16 | s.channel << 24, 0, 0, UINT32_MAX});
+			}
+			return dfd;
+		}
+
+		template<class T>
+		T read(std::span<const std::byte> data, uint64_t offset)
+		{
+			if(offset + sizeof(T) > data.size())
+				throw std::runtime_error("truncated KTX2 file");
+			T t;
+			std::memcpy(&t, data.data() + offset, sizeof(T));
+			return t;
+		}
+
+		uint64_t align(uint64_t offset, uint64_t alignment)
+		{
+			return (offset + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	std::span<const std::byte> ktx2_image::value(std::string_view key) const
+	{
+		auto it = std::find_if(values.begin(), values.end(), [key](const auto& v){ return v.first == key; });
+		return it == values.end() ? std::span<const std::byte>() : it->second;
+	}
+
+	size_t block_size(vk::Format format)
+	{
+		switch(format)
+		{
+			case vk::Format::eBc1RgbUnormBlock:
+			case vk::Format::eBc1RgbSrgbBlock:
+			case vk::Format::eBc1RgbaUnormBlock:
+			case vk::Format::eBc1RgbaSrgbBlock:
+				return 8;
+			case vk::Format::eBc3UnormBlock:
+			case vk::Format::eBc3SrgbBlock:
+			case vk::Format::eBc5UnormBlock:
+			case vk::Format::eBc5SnormBlock:
+			case vk::Format::eBc7UnormBlock:
+			case vk::Format::eBc7SrgbBlock:
+				return 16;
+			default:
+				return 0;
+		}
+	}
+
+	ktx2_image parse_ktx2(std::span<const std::byte> data)
+	{
+		ktx2_header header = read<ktx2_header>(data, 0);
+		if(header.identifier != identifier)
+			throw std::runtime_error("not a KTX2 file");
+
+		ktx2_image image;
+		image.format = static_cast<vk::Format>(header.vkFormat);
+		image.width = header.pixelWidth;
+		image.height = header.pixelHeight;
+		size_t blockSize = block_size(image.format);
+		if(blockSize == 0)
+			throw std::runtime_error("unsupported KTX2 format "+vk::to_string(image.format));
+		if(header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || image.width == 0 || image.height == 0)
+			throw std::runtime_error("only single 2D images are supported in KTX2 files");
+		if(header.supercompressionScheme != 0)
+			throw std::runtime_error("supercompressed KTX2 files are not supported");
+
+		uint32_t levelCount = std::max(header.levelCount, 1u);
+		for(uint32_t level=0; level<levelCount; level++)
+		{
+			ktx2_level l = read<ktx2_level>(data, sizeof(ktx2_header) + level * sizeof(ktx2_level));
+			size_t expected = bc_size(std::max(image.width >> level, 1u), std::max(image.height >> level, 1u), blockSize);
+			if(l.byteLength != expected || l.byteOffset > data.size() || l.byteLength > data.size() - l.byteOffset)
+				throw std::runtime_error("invalid level "+std::to_string(level)+" in KTX2 file");
+			image.levels.push_back(data.subspan(l.byteOffset, l.byteLength));
+		}
+
+		uint64_t end = uint64_t(header.kvdByteOffset) + header.kvdByteLength;
+		if(end > data.size())
+			throw std::runtime_error("truncated KTX2 file");
+		for(uint64_t offset = header.kvdByteOffset; offset + 4 <= end;)
+		{
+			uint32_t length = read<uint32_t>(data, offset);
+			if(offset + 4 + length > end)
+				throw std::runtime_error("invalid key/value data in KTX2 file");
+			std::string_view entry(reinterpret_cast<const char*>(data.data() + offset + 4), length);
+			size_t split = entry.find('\0');
+			if(split == std::string_view::npos)
+				throw std::runtime_error("invalid key/value data in KTX2 file");
+			image.values.emplace_back(entry.substr(0, split), data.subspan(offset + 4 + split + 1, length - split - 1));
+			offset = align(offset + 4 + length, 4);
+		}
+		return image;
+	}
+
+	std::vector<std::byte> write_ktx2(vk::Format format, uint32_t width, uint32_t height,
+		const std::vector<std::span<const std::byte>>& levels, const ktx2_values& values)
+	{
+		std::vector<uint32_t> dfd = data_format_descriptor(format);
+
+		std::vector<std::byte> kvd;
+		for(const auto& [key, value] : values)
+		{
+			uint32_t length = static_cast<uint32_t>(key.size() + 1 + value.size());
+			size_t offset = kvd.size();
+			kvd.resize(align(offset + 4 + length, 4));
+			std::memcpy(kvd.data() + offset, &length, 4);
+			std::memcpy(kvd.data() + offset + 4, key.data(), key.size());
+			std::memcpy(kvd.data() + offset + 4 + key.size() + 1, value.data(), value.size());
+		}
+
+		ktx2_header header = {
+			.identifier = identifier,
+			.vkFormat = static_cast<uint32_t>(format),
+			.typeSize = 1,
+			.pixelWidth = width,
+			.pixelHeight = height,
+			.pixelDepth = 0,
+			.layerCount = 0,
+			.faceCount = 1,
+			.levelCount = static_cast<uint32_t>(levels.size()),
+			.supercompressionScheme = 0
+		};
+		header.dfdByteOffset = static_cast<uint32_t>(sizeof(header) + levels.size() * sizeof(ktx2_level));
+		header.dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+		header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+		header.kvdByteLength = static_cast<uint32_t>(kvd.size());
+
+		// the smallest level comes first, every level is aligned to a whole block
+		std::vector<ktx2_level> index(levels.size());
+		uint64_t offset = uint64_t(header.kvdByteOffset) + header.kvdByteLength;
+		for(size_t level=levels.size(); level-- > 0;)
+		{
+			offset = align(offset, block_size(format));
+			index[level] = ktx2_level{offset, levels[level].size(), levels[level].size()};
+			offset += levels[level].size();
+		}
+
+		std::vector<std::byte> out(offset);
+		std::memcpy(out.data(), &header, sizeof(header));
+		std::memcpy(out.data() + sizeof(header), index.data(), index.size() * sizeof(ktx2_level));
+		std::memcpy(out.data() + header.dfdByteOffset, dfd.data(), header.dfdByteLength);
+		std::memcpy(out.data() + header.kvdByteOffset, kvd.data(), kvd.size());
+		for(size_t level=0; level<levels.size(); level++)
+			std::memcpy(out.data() + index[level].byteOffset, levels[level].data(), levels[level].size());
+		return out;
+	}
+}
@@ -0,0 +1,98 @@
+#include "render/loader_metrics.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace render
+{
+	namespace
+	{
+		constexpr unsigned int subBucketBits = 2;
+
+		unsigned int bucket(uint64_t value)
+		{
+			constexpr uint64_t linear = 1 << subBucketBits;
+			if(value < linear)
+				return value;
+			unsigned int exponent = std::bit_width(value) - 1;
+			unsigned int mantissa = (value >> (exponent - subBucketBits)) & (linear - 1);
+			return (exponent - subBucketBits + 1) * linear + mantissa;
+		}
+
+		// middle of the values falling into a bucket
+		uint64_t bucket_value(unsigned int index)
+		{
+			constexpr uint64_t linear = 1 << subBucketBits;
+			if(index < linear)
+				return index;
+			unsigned int exponent = index / linear + subBucketBits - 1;
+			uint64_t width = uint64_t(1) << (exponent - subBucketBits);
+			return (linear + index % linear) * width + width / 2;
+		}
+	}
+
+	const char* stage_name(LoadStage stage)
+	{
+		switch(stage)
+		{
+			case StageQueued: return "Queued";
+			case StageRead: return "Read";
+			case StageDecode: return "Decode";
+			case StageStaging: return "Staging";
+			case StageTransfer: return "Transfer";
+			case StageFenceWait: return "Fence Wait";
+			default: return "Unknown";
+		}
+	}
+
+	void latency_histogram::record(std::chrono::nanoseconds time)
+	{
+		uint64_t value = std::max<int64_t>(time.count(), 0);
+		buckets[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+		samples.fetch_add(1, std::memory_order_relaxed);
+		sum.fetch_add(value, std::memory_order_relaxed);
+	}
+
+	std::chrono::nanoseconds latency_histogram::mean() const
+	{
+		uint64_t n = count();
+		return std::chrono::nanoseconds(n ? sum.load(std::memory_order_relaxed) / n : 0);
+	}
+
+	std::chrono::nanoseconds latency_histogram::percentile(double p) const
+	{
+		// buckets are read one by one while others record, so count them instead of trusting samples
+		std::array<uint64_t, bucketCount> counts;
+		uint64_t n = 0;
+		for(unsigned int i=0; i<bucketCount; i++)
+		{
+			counts[i] = buckets[i].load(std::memory_order_relaxed);
+			n += counts[i];
+		}
+		if(n == 0)
+			return std::chrono::nanoseconds(0);
+
+		uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(p * n + 0.5), 1);
+		uint64_t seen = 0;
+		for(unsigned int i=0; i<bucketCount; i++)
+		{
+			seen += counts[i];
+			if(seen >= rank)
+				return std::chrono::nanoseconds(bucket_value(i));
+		}
+		return std::chrono::nanoseconds(bucket_value(bucketCount - 1));
+	}
+
+	void thread_metrics::record(uint64_t bytes, std::chrono::nanoseconds time)
+	{
+		tasks.fetch_add(1, std::memory_order_relaxed);
+		this->bytes.fetch_add(bytes, std::memory_order_relaxed);
+		busy.fetch_add(time.count(), std::memory_order_relaxed);
+	}
+
+	double thread_metrics::bytesPerSecond() const
+	{
+		int64_t time = busy.load(std::memory_order_relaxed);
+		return time > 0 ? bytes.load(std::memory_order_relaxed) * 1e9 / time : 0.0;
+	}
+}
@@ -0,0 +1,60 @@
+#include "render/mapped_file.hpp"
+
+#include <stdexcept>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace render
+{
+	mapped_file::mapped_file(const std::string& filename, bool populate)
+	{
+		int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+		if(fd < 0)
+			throw std::runtime_error("failed to open \""+filename+"\": "+std::strerror(errno));
+
+		struct stat st;
+		if(fstat(fd, &st) != 0)
+		{
+			close(fd);
+			throw std::runtime_error("failed to stat \""+filename+"\": "+std::strerror(errno));
+		}
+		length = st.st_size;
+
+		// mmap does not accept empty mappings, an empty file is simply an empty view
+		if(length > 0)
+		{
+			address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(address == MAP_FAILED)
+			{
+				address = nullptr;
+				close(fd);
+				throw std::runtime_error("failed to map \""+filename+"\": "+std::strerror(errno));
+			}
+			madvise(address, length, MADV_SEQUENTIAL);
+			if(populate)
+			{
+#ifdef MADV_POPULATE_READ
+				if(madvise(address, length, MADV_POPULATE_READ) != 0)
+#endif
+				{
+					// older kernels, touch every page
+					long page = sysconf(_SC_PAGESIZE);
+					const volatile uint8_t* p = static_cast<const uint8_t*>(address);
+					for(size_t i=0; i<length; i+=page)
+						(void)p[i];
+				}
+			}
+		}
+		close(fd);
+	}
+
+	mapped_file::~mapped_file()
+	{
+		if(address)
+			munmap(address, length);
+	}
+}
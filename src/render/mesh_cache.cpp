@@ -0,0 +1,176 @@
+#include "render/mesh_cache.hpp"
+#include "config.hpp"
+#include "utils.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+namespace render
+{
+	namespace
+	{
+		std::filesystem::path cache_path(const std::filesystem::path& source)
+		{
+			const std::filesystem::path& directory = config::CONFIG.meshCacheDirectory;
+			if(directory.empty())
+				return source.string()+".vkmesh";
+
+			std::string key = source.string();
+			return directory / fmt::format("{:016x}.vkmesh", utils::content_hash(key.data(), key.size()));
+		}
+
+		int64_t source_time(const std::filesystem::path& source, std::error_code& ec)
+		{
+			return std::filesystem::last_write_time(source, ec).time_since_epoch().count();
+		}
+
+		uint64_t align(uint64_t offset, uint64_t alignment)
+		{
+			return (offset + alignment - 1) / alignment * alignment;
+		}
+
+		bool valid(const cached_mesh& mesh, const std::string& source, const model_options& options)
+		{
+			if(mesh.size() < sizeof(mesh_cache_header))
+				return false;
+
+			const mesh_cache_header& header = mesh.header();
+			if(header.magic != mesh_cache_header::expectedMagic || header.version != mesh_cache_header::currentVersion ||
+				header.flags != options.flags())
+				return false;
+			// the buffers are sized by the counts with the strides model::create_buffers picks, others would overrun them
+			uint32_t vertexStride = options.quantize ? sizeof(packed_vertex_data) : sizeof(vertex_data);
+			uint32_t indexStride = header.vertexCount <= std::numeric_limits<uint16_t>::max() ? sizeof(uint16_t) : sizeof(uint32_t);
+			if(header.vertexStride != vertexStride || header.indexStride != indexStride)
+				return false;
+			if(sizeof(mesh_cache_header) + header.pathLength > mesh.size() || mesh.path() != source)
+				return false;
+			auto fits = [&mesh](uint64_t offset, uint64_t size){
+				// without offset + size, which could wrap just like the products
+				return size == 0 || (offset <= mesh.size() && size <= mesh.size() - offset);
+			};
+			return fits(header.vertexOffset, uint64_t(header.vertexCount) * header.vertexStride) &&
+				fits(header.indexOffset, uint64_t(header.indexCount) * header.indexStride) &&
+				fits(header.meshletOffset, uint64_t(header.meshletCount) * sizeof(meshlet)) &&
+				fits(header.lodOffset, uint64_t(header.lodCount) * sizeof(model_lod));
+		}
+	}
+
+	std::unique_ptr<cached_mesh> find_cached_mesh(const std::string& filename, const model_options& options)
+	{
+		std::error_code ec;
+		std::filesystem::path source = std::filesystem::canonical(filename, ec);
+		if(ec)
+			return nullptr;
+		std::filesystem::path path = cache_path(source);
+		if(!std::filesystem::exists(path, ec))
+			return nullptr;
+
+		std::unique_ptr<cached_mesh> mesh;
+		try
+		{
+			mesh = std::make_unique<cached_mesh>(path.string());
+		}
+		catch(const std::exception& e)
+		{
+			spdlog::warn("Cannot read mesh cache {}: {}", path.string(), e.what());
+			return nullptr;
+		}
+		if(!valid(*mesh, source.string(), options))
+			return nullptr;
+
+		const mesh_cache_header& header = mesh->header();
+		uint64_t size = std::filesystem::file_size(source, ec);
+		if(ec || header.sourceSize != size)
+			return nullptr;
+		int64_t time = source_time(source, ec);
+		if(ec)
+			return nullptr;
+
+		if(header.sourceTime != time)
+		{
+			// touched but maybe not modified (e.g. by a checkout), so compare the content before giving up
+			mapped_file obj(source.string());
+			if(utils::content_hash(obj.data(), obj.size()) != header.sourceHash)
+				return nullptr;
+
+			std::fstream out(path, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+			out.seekp(offsetof(mesh_cache_header, sourceTime));
+			out.write(reinterpret_cast<const char*>(&time), sizeof(time));
+		}
+		return mesh;
+	}
+
+	void store_cached_mesh(const std::string& filename, const model_options& options, std::string_view source,
+		const model& mesh, std::span<const std::byte> vertices, std::span<const std::byte> indices)
+	{
+		std::error_code ec;
+		std::filesystem::path sourcePath = std::filesystem::canonical(filename, ec);
+		if(ec)
+			return;
+		std::filesystem::path path = cache_path(sourcePath);
+		if(path.has_parent_path())
+			std::filesystem::create_directories(path.parent_path(), ec);
+
+		int64_t time = source_time(sourcePath, ec);
+		if(ec)
+			return;
+
+		std::string key = sourcePath.string();
+		mesh_cache_header header = {
+			.magic = mesh_cache_header::expectedMagic,
+			.version = mesh_cache_header::currentVersion,
+			.flags = options.flags(),
+			.pathLength = static_cast<uint32_t>(key.size()),
+			.sourceSize = source.size(),
+			.sourceTime = time,
+			.sourceHash = utils::content_hash(source.data(), source.size()),
+			.vertexCount = static_cast<uint32_t>(mesh.vertexCount),
+			.indexCount = static_cast<uint32_t>(mesh.indexCount),
+			.vertexStride = mesh.vertexStride(),
+			.indexStride = mesh.indexStride(),
+			.meshletCount = static_cast<uint32_t>(mesh.meshlets.size()),
+			.lodCount = static_cast<uint32_t>(mesh.lods.size()),
+			.min = mesh.min,
+			.max = mesh.max
+		};
+		header.vertexOffset = align(sizeof(header) + key.size(), 16);
+		header.indexOffset = align(header.vertexOffset + vertices.size(), 16);
+		header.meshletOffset = align(header.indexOffset + indices.size(), 16);
+		header.lodOffset = align(header.meshletOffset + mesh.meshlets.size() * sizeof(meshlet), 16);
+
+		// write to a temporary file first, so no loader ever maps a half-written cache
+		std::filesystem::path temp = path;
+		temp += fmt::format(".{:x}.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+		{
+			std::ofstream out(temp, std::ios_base::binary | std::ios_base::trunc);
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.write(key.data(), key.size());
+			out.seekp(header.vertexOffset);
+			out.write(reinterpret_cast<const char*>(vertices.data()), vertices.size());
+			out.seekp(header.indexOffset);
+			out.write(reinterpret_cast<const char*>(indices.data()), indices.size());
+			out.seekp(header.meshletOffset);
+			out.write(reinterpret_cast<const char*>(mesh.meshlets.data()), mesh.meshlets.size() * sizeof(meshlet));
+			out.seekp(header.lodOffset);
+			out.write(reinterpret_cast<const char*>(mesh.lods.data()), mesh.lods.size() * sizeof(model_lod));
+			if(!out)
+			{
+				spdlog::warn("Failed to write mesh cache {}", temp.string());
+				out.close();
+				std::filesystem::remove(temp, ec);
+				return;
+			}
+		}
+		std::filesystem::rename(temp, path, ec);
+		if(ec)
+		{
+			spdlog::warn("Failed to store mesh cache {}: {}", path.string(), ec.message());
+			std::filesystem::remove(temp, ec);
+		}
+	}
+}
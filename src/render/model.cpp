@@ -1,5 +1,7 @@
 #include "render/model.hpp"
 
+#include <cmath>
+
 namespace render
 {
 	std::array<vk::VertexInputAttributeDescription, 3> vertex_data::attributes(uint32_t binding)
@@ -11,6 +13,15 @@ namespace render
 		};
 	}
 
+	std::array<vk::VertexInputAttributeDescription, 3> packed_vertex_data::attributes(uint32_t binding)
+	{
+		return {
+			vk::VertexInputAttributeDescription(0, binding, vk::Format::eR16G16B16A16Unorm, offsetof(packed_vertex_data, position)),
+			vk::VertexInputAttributeDescription(1, binding, vk::Format::eR8G8Snorm, offsetof(packed_vertex_data, normal)),
+			vk::VertexInputAttributeDescription(2, binding, vk::Format::eR16G16Sfloat, offsetof(packed_vertex_data, texCoord)),
+		};
+	}
+
 	model::model(vk::Device device, vma::Allocator allocator) : device(device), allocator(allocator)
 	{
 
@@ -26,14 +37,67 @@ namespace render
 	{
 		vertexCount = vc;
 		indexCount = ic;
+		// 0xFFFF stays unused, so primitive restart can never be triggered by accident
+		indexType = vertexCount <= std::numeric_limits<uint16_t>::max() ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
 
-		vk::BufferCreateInfo vertex_info({}, sizeof(vertex_data)*vertexCount, 
+		vk::BufferCreateInfo vertex_info({}, vertexStride()*vertexCount, 
 			vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive);
-		vk::BufferCreateInfo index_info({}, sizeof(uint32_t)*indexCount, 
+		vk::BufferCreateInfo index_info({}, indexStride()*indexCount, 
 			vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive);
 		vma::AllocationCreateInfo alloc_info({}, vma::MemoryUsage::eGpuOnly);
 
 		auto [vb, va] = allocator.createBuffer(vertex_info, alloc_info); vertexBuffer = vb; vertexAllocation = va;
 		auto [ib, ia] = allocator.createBuffer(index_info, alloc_info); indexBuffer = ib; indexAllocation = ia;
 	}
+
+	void model::destroy_buffers()
+	{
+		allocator.destroyBuffer(vertexBuffer, vertexAllocation);
+		allocator.destroyBuffer(indexBuffer, indexAllocation);
+		vertexBuffer = vk::Buffer();
+		vertexAllocation = vma::Allocation();
+		indexBuffer = vk::Buffer();
+		indexAllocation = vma::Allocation();
+	}
+
+	uint32_t model::vertexStride() const
+	{
+		return vertexFormat == vertex_format::Packed ? sizeof(packed_vertex_data) : sizeof(vertex_data);
+	}
+
+	uint32_t model::indexStride() const
+	{
+		return indexType == vk::IndexType::eUint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	}
+
+	void model::bind(vk::CommandBuffer commandBuffer, uint32_t binding) const
+	{
+		commandBuffer.bindVertexBuffers(binding, vertexBuffer, {0});
+		commandBuffer.bindIndexBuffer(indexBuffer, 0, indexType);
+	}
+
+	void model::draw(vk::CommandBuffer commandBuffer, uint32_t lod, uint32_t instanceCount) const
+	{
+		if(lods.empty())
+			commandBuffer.drawIndexed(indexCount, instanceCount, 0, 0, 0);
+		else
+			commandBuffer.drawIndexed(lods[lod].indexCount, instanceCount, lods[lod].firstIndex, 0, 0);
+	}
+
+	float model::screen_size(float distance, float fovY, float viewportHeight) const
+	{
+		distance = std::max(distance, std::numeric_limits<float>::epsilon());
+		return glm::length(max - min) * viewportHeight / (2.0f * distance * std::tan(fovY * 0.5f));
+	}
+
+	uint32_t model::select_lod(float screenSize, float maxError) const
+	{
+		uint32_t lod = 0;
+		for(uint32_t i=1; i<lods.size(); i++)
+		{
+			if(lods[i].error * screenSize <= maxError)
+				lod = i;
+		}
+		return lod;
+	}
 }
\ No newline at end of file
@@ -6,7 +6,7 @@ namespace render
 	phase::phase(window* window) : 
 		win(window),
 		instance(window->instance.get()), device(window->device.get()), 
-		allocator(window->allocator), loader(window->loader.get()),
+		allocator(window->allocator), loader(window->loader.get()), residency(window->residency.get()), renderExecutor(&window->renderExecutor),
 		graphicsQueue(window->graphicsQueue), graphicsFamily(window->queueFamilyIndices.graphicsFamily.value())
 	{
 
@@ -0,0 +1,212 @@
+#include "render/residency.hpp"
+#include "config.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+using namespace config;
+
+namespace render
+{
+	residency_manager::residency_manager(vma::Allocator allocator, vk::PhysicalDeviceMemoryProperties memoryProperties,
+		resource_loader* loader, vk::Device device, unsigned int framesInFlight)
+		: allocator(allocator), memoryProperties(memoryProperties), loader(loader), device(device), framesInFlight(framesInFlight)
+	{
+	}
+
+	residency_manager::~residency_manager()
+	{
+		// the loader must be done with everything before it is freed
+		for(auto& e : entries)
+		{
+			if(e->state == residency_state::Loading)
+				e->shared.ready.wait();
+		}
+	}
+
+	resident<texture> residency_manager::loadTexture(std::string filename, LoadPriority priority, uint32_t mipLevels, vk::Format format)
+	{
+		auto entry = std::make_shared<residency_entry>(residency_entry{.type = LoadType::Texture, .filename = filename,
+			.priority = priority, .mipLevels = mipLevels, .format = format});
+		load(*entry);
+		entries.push_back(entry);
+		return resident<texture>(this, entry);
+	}
+
+	resident<model> residency_manager::loadModel(std::string filename, model_options options, LoadPriority priority)
+	{
+		auto entry = std::make_shared<residency_entry>(residency_entry{.type = LoadType::Model, .filename = filename,
+			.priority = priority, .modelOptions = options});
+		load(*entry);
+		entries.push_back(entry);
+		return resident<model>(this, entry);
+	}
+
+	void residency_manager::load(residency_entry& entry)
+	{
+		if(entry.type == LoadType::Texture)
+		{
+			auto shared = loader->loadSharedTexture(entry.filename, entry.priority, entry.mipLevels, entry.format);
+			entry.shared = SharedResource<void>{shared.resource, shared.ready, shared.token};
+		}
+		else
+		{
+			auto shared = loader->loadSharedModel(entry.filename, entry.modelOptions, entry.priority);
+			entry.shared = SharedResource<void>{shared.resource, shared.ready, shared.token};
+		}
+		// used again before it was freed, the loader's cache handed out the very same object
+		auto it = std::find_if(retired.begin(), retired.end(), [&entry](const retired_resource& r){
+			return r.resource == entry.shared.resource;
+		});
+		if(it != retired.end())
+		{
+			retiredBytes -= it->size;
+			retired.erase(it);
+		}
+		entry.state = residency_state::Loading;
+		entry.lastUse = currentFrame; // not evicted before anyone had the chance to use it
+		entry.generation++;
+	}
+
+	void residency_manager::poll(residency_entry& entry)
+	{
+		if(entry.state != residency_state::Loading ||
+			entry.shared.ready.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return;
+		try
+		{
+			entry.shared.ready.get();
+			entry.state = residency_state::Resident;
+			entry.size = allocation_size(entry);
+			trackedBytes += entry.size;
+		}
+		catch(const std::exception& ex)
+		{
+			spdlog::error("[Residency] Failed to load {}: {}", entry.filename, ex.what());
+			entry.state = residency_state::Failed;
+			entry.shared = {};
+		}
+	}
+
+	void* residency_manager::use(residency_entry& entry, upload_waits& waits)
+	{
+		entry.lastUse = currentFrame;
+		if(entry.state == residency_state::Evicted)
+		{
+			spdlog::debug("[Residency] Reloading {}", entry.filename);
+			load(entry);
+			reloadCount++;
+		}
+		poll(entry);
+		if(entry.state == residency_state::Failed || !waits.use(entry.shared))
+			return nullptr;
+		return entry.shared.resource.get();
+	}
+
+	vk::DeviceSize residency_manager::allocation_size(const residency_entry& entry) const
+	{
+		if(entry.type == LoadType::Texture)
+		{
+			auto tex = static_cast<const texture*>(entry.shared.resource.get());
+			return allocator.getAllocationInfo(tex->allocation).size;
+		}
+		auto mesh = static_cast<const model*>(entry.shared.resource.get());
+		return allocator.getAllocationInfo(mesh->vertexAllocation).size + allocator.getAllocationInfo(mesh->indexAllocation).size;
+	}
+
+	void residency_manager::retire(residency_entry& entry)
+	{
+		if(entry.state == residency_state::Resident)
+			trackedBytes -= entry.size;
+		// frames still in flight might use it
+		retired.push_back(retired_resource{std::move(entry.shared.resource), entry.size, currentFrame});
+		retiredBytes += entry.size;
+		entry.shared = {};
+		entry.state = residency_state::Evicted;
+	}
+
+	vk::DeviceSize residency_manager::excess()
+	{
+		if(CONFIG.residencyBudget > 0)
+		{
+			lastBudget = CONFIG.residencyBudget;
+			lastUsage = trackedBytes;
+			return lastUsage > lastBudget ? lastUsage - lastBudget : 0;
+		}
+
+		std::array<vma::Budget, VK_MAX_MEMORY_HEAPS> budgets{};
+		allocator.getBudget(budgets.data());
+		vk::DeviceSize usage = 0, budget = 0;
+		for(uint32_t i=0; i<memoryProperties.memoryHeapCount; i++)
+		{
+			if(!(memoryProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal))
+				continue;
+			usage += budgets[i].usage;
+			budget += budgets[i].budget;
+		}
+		lastBudget = static_cast<vk::DeviceSize>(budget * CONFIG.residencyBudgetShare);
+		// evicted resources are as good as freed already
+		lastUsage = usage - std::min(usage, retiredBytes);
+		return lastUsage > lastBudget ? lastUsage - lastBudget : 0;
+	}
+
+	void residency_manager::next_frame()
+	{
+		currentFrame++;
+		while(!retired.empty() && retired.front().frame + framesInFlight <= currentFrame)
+		{
+			retiredBytes -= retired.front().size;
+			retired.pop_front();
+		}
+
+		// handles nobody holds anymore
+		std::erase_if(entries, [this](const std::shared_ptr<residency_entry>& e){
+			if(e.use_count() > 1)
+				return false;
+			poll(*e);
+			if(e->state == residency_state::Loading)
+				return false;
+			if(e->state == residency_state::Resident)
+				retire(*e);
+			return true;
+		});
+
+		for(auto& e : entries)
+			poll(*e);
+
+		vk::DeviceSize over = excess();
+		if(over == 0)
+			return;
+
+		// resources used by the last frame are part of the working set, evicting them would only load them again right away.
+		// Neither are those still held by someone else, which would free nothing.
+		std::vector<residency_entry*> candidates;
+		for(auto& e : entries)
+		{
+			if(e->state == residency_state::Resident && e->lastUse + 1 < currentFrame && e->shared.resource.use_count() == 1)
+				candidates.push_back(e.get());
+		}
+		std::sort(candidates.begin(), candidates.end(), [](auto a, auto b){ return a->lastUse < b->lastUse; });
+
+		vk::DeviceSize freed = 0;
+		unsigned int count = 0;
+		for(auto e : candidates)
+		{
+			if(freed >= over)
+				break;
+			freed += e->size;
+			retire(*e);
+			count++;
+		}
+		evictionCount += count;
+		if(count > 0)
+			spdlog::debug("[Residency] Evicted {} resource(s) with {} KiB, {} KiB were over the budget of {} KiB",
+				count, freed/1024, over/1024, lastBudget/1024);
+	}
+
+	size_t residency_manager::residentCount() const
+	{
+		return std::count_if(entries.begin(), entries.end(), [](const auto& e){ return e->state == residency_state::Resident; });
+	}
+}
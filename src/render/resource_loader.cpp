@@ -1,73 +1,307 @@
 #include "render/resource_loader.hpp"
 #include "render/debug.hpp"
 #include "render/obj_loader.hpp"
+#include "render/mapped_file.hpp"
+#include "render/mesh_cache.hpp"
+#include "render/mesh_optimizer.hpp"
+#include "render/quantization.hpp"
+#include "render/meshlets.hpp"
+#include "render/simplifier.hpp"
+#include "render/staging_stream.hpp"
+#include "render/mipmap.hpp"
+#include "render/texture_cache.hpp"
+#include "config.hpp"
 
 #include <vk_mem_alloc.hpp>
 #include <spdlog/spdlog.h>
 #include <spng.h>
 
+#include <algorithm>
+#include <filesystem>
+#include <iterator>
 #include <fstream>
+#include <memory>
+#include <stdexcept>
 #include <chrono>
+#include <cstring>
+#include <span>
 
 namespace render
 {
+	namespace
+	{
+		unsigned int decoder_count()
+		{
+			unsigned int count = config::CONFIG.loaderDecodeThreads;
+			if(count == 0)
+				count = std::max(std::thread::hardware_concurrency(), 1u);
+			return count;
+		}
+
+		// Owns whatever has to live until a task is done and completes its token once the promise is fulfilled.
+		// The staging stream releases it right after fulfilling the promise.
+		struct task_done
+		{
+			std::shared_ptr<void> owner;
+			std::shared_ptr<LoadToken> token;
+
+			~task_done() { token->complete(); }
+		};
+		std::shared_ptr<void> completion(LoadTask& task)
+		{
+			return std::make_shared<task_done>(std::move(task.owner), task.token);
+		}
+
+		// for tasks that are dropped, their futures fail with std::future_errc::broken_promise
+		void abandon(LoadTask& task)
+		{
+			task.promise = std::promise<void>();
+			task.token->complete();
+		}
+	}
+
 	resource_loader::resource_loader(vk::Device device, vma::Allocator allocator,
 		uint32_t transferFamily, uint32_t graphicsFamily,
-		std::vector<vk::Queue> queues) : device(device), allocator(allocator), transferFamily(transferFamily), graphicsFamily(graphicsFamily)
+		std::vector<vk::Queue> queues, bool textureCompressionBC, bool timelineSemaphore, vk::Extent3D transferGranularity)
+		: device(device), allocator(allocator),
+		transferFamily(transferFamily), graphicsFamily(graphicsFamily), textureCompressionBC(textureCompressionBC),
+		timelineSemaphore(timelineSemaphore), transferGranularity(transferGranularity),
+		loaderMetrics(decoder_count(), queues.size())
 	{
+		unsigned int decoderCount = loaderMetrics.decoders.size();
+		maxDecoded = decoderCount * 2;
+
+		for(unsigned int i=0; i<decoderCount; i++)
+		{
+			decoders.emplace_back(&resource_loader::decodeThread, this, i);
+		}
 		int index = 0;
 		for(auto& queue : queues)
 		{
-			threads.emplace_back(&resource_loader::loadThread, this, index, queue);
+			submitters.emplace_back(&resource_loader::submitThread, this, index, queue);
 			index++;
 		}
 	}
 
 	resource_loader::~resource_loader()
 	{
-		quit = true;
+		{
+			std::scoped_lock<std::mutex> l(lock);
+			quit = true;
+		}
 		cv.notify_all();
-		for(auto& t : threads)
+		decodedCv.notify_all();
+		for(auto& t : decoders)
+		{
+			if(t.joinable())
+				t.join();
+		}
+		for(auto& t : submitters)
 		{
 			if(t.joinable())
 				t.join();
 		}
+
+		while(!tasks.empty())
+		{
+			LoadTask task = tasks.pop();
+			abandon(task);
+		}
+		while(!decoded.empty())
+		{
+			DecodedTask d = decoded.pop();
+			abandon(d.task);
+		}
 	}
 
-	std::future<void> resource_loader::loadTexture(texture* image, std::string filename)
+	LoadFuture resource_loader::enqueue(LoadTask task)
 	{
-		std::future<void> f;
+		LoadFuture f(task.promise.get_future(), task.token);
 		{
 			std::scoped_lock<std::mutex> l(lock);
-			tasks.push(LoadTask{.type = LoadType::Texture, .src = filename, .dst = image, .promise = std::promise<void>()});
-			f = tasks.back().promise.get_future();
+			LoadPriority priority = task.priority;
+			tasks.push(std::move(task), priority);
+			loaderMetrics.waiting = tasks.size();
 		}
 		cv.notify_one();
 		return f;
 	}
 
-	std::future<void> resource_loader::loadTexture(texture* image, LoaderFunction func)
+	LoadFuture resource_loader::loadTexture(texture* image, std::string filename, LoadPriority priority)
+	{
+		return enqueue(LoadTask{.type = LoadType::Texture, .src = filename, .dst = image, .promise = std::promise<void>(), .priority = priority});
+	}
+
+	LoadFuture resource_loader::loadTexture(texture* image, LoaderFunction func, LoadPriority priority)
+	{
+		return enqueue(LoadTask{.type = LoadType::Texture, .src = func, .dst = image, .promise = std::promise<void>(), .priority = priority});
+	}
+
+	LoadFuture resource_loader::loadModel(model* model, std::string filename, model_options options, LoadPriority priority)
+	{
+		return enqueue(LoadTask{.type = LoadType::Model, .src = filename, .dst = model, .promise = std::promise<void>(),
+			.modelOptions = options, .priority = priority});
+	}
+
+	LoadFuture resource_loader::uploadBuffer(vk::Buffer buffer, vk::DeviceSize offset, std::span<const std::byte> data, LoadPriority priority)
+	{
+		return enqueue(LoadTask{.type = LoadType::Buffer, .src = data, .dst = buffer, .promise = std::promise<void>(),
+			.offset = offset, .priority = priority});
+	}
+
+	LoadFuture resource_loader::uploadBuffer(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size, LoaderFunction loader, LoadPriority priority)
+	{
+		return enqueue(LoadTask{.type = LoadType::Buffer, .src = loader, .dst = buffer, .promise = std::promise<void>(),
+			.offset = offset, .size = size, .priority = priority});
+	}
+
+	LoadFuture resource_loader::uploadImage(vk::Image image, image_region region, std::span<const std::byte> data, LoadPriority priority)
+	{
+		return enqueue(LoadTask{.type = LoadType::Image, .src = data, .dst = image, .promise = std::promise<void>(),
+			.region = region, .priority = priority});
+	}
+
+	LoadFuture resource_loader::uploadImage(vk::Image image, image_region region, vk::DeviceSize size, LoaderFunction loader, LoadPriority priority)
+	{
+		return enqueue(LoadTask{.type = LoadType::Image, .src = loader, .dst = image, .promise = std::promise<void>(),
+			.size = size, .region = region, .priority = priority});
+	}
+
+	std::string resource_loader::cache_key(const std::string& filename, const std::string& options)
+	{
+		std::error_code ec;
+		std::filesystem::path path = std::filesystem::canonical(filename, ec);
+		if(ec)
+			return filename+"|"+options;
+		auto time = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+		return fmt::format("{}|{}|{}", path.string(), time, options);
+	}
+
+	template<class T>
+	SharedResource<T> resource_loader::find_shared(const std::string& key)
+	{
+		auto it = cache.find(key);
+		if(it == cache.end())
+			return {};
+		std::shared_ptr<void> resource = it->second.resource.lock();
+		if(!resource)
+			return {};
+		return SharedResource<T>{std::static_pointer_cast<T>(resource), it->second.ready, it->second.token};
+	}
+
+	SharedResource<texture> resource_loader::loadSharedTexture(std::string filename, LoadPriority priority, uint32_t mipLevels, vk::Format format)
+	{
+		std::string key = cache_key(filename, fmt::format("texture {} {}", mipLevels, static_cast<uint32_t>(format)));
+		std::scoped_lock<std::mutex> l(cacheLock);
+		if(auto shared = find_shared<texture>(key); shared.resource)
+			return shared;
+
+		auto tex = std::make_shared<texture>(device, allocator, vk::ImageUsageFlagBits::eSampled, format,
+			vk::SampleCountFlagBits::e1, true, vk::ImageAspectFlagBits::eColor, mipLevels);
+		LoadTask task{.type = LoadType::Texture, .src = filename, .dst = tex.get(),
+			.promise = std::promise<void>(), .priority = priority, .owner = tex};
+		std::shared_ptr<LoadToken> token = task.token;
+		std::shared_future<void> ready = enqueue(std::move(task)).share();
+		std::erase_if(cache, [](const auto& e){ return e.second.resource.expired(); });
+		cache[key] = cache_entry{tex, ready, token};
+		return SharedResource<texture>{tex, ready, token};
+	}
+
+	SharedResource<model> resource_loader::loadSharedModel(std::string filename, model_options options, LoadPriority priority)
+	{
+		std::string key = cache_key(filename, fmt::format("model {}", options.flags()));
+		std::scoped_lock<std::mutex> l(cacheLock);
+		if(auto shared = find_shared<model>(key); shared.resource)
+			return shared;
+
+		auto mesh = std::make_shared<model>(device, allocator);
+		LoadTask task{.type = LoadType::Model, .src = filename, .dst = mesh.get(),
+			.promise = std::promise<void>(), .modelOptions = options, .priority = priority, .owner = mesh};
+		std::shared_ptr<LoadToken> token = task.token;
+		std::shared_future<void> ready = enqueue(std::move(task)).share();
+		std::erase_if(cache, [](const auto& e){ return e.second.resource.expired(); });
+		cache[key] = cache_entry{mesh, ready, token};
+		return SharedResource<model>{mesh, ready, token};
+	}
+
+	bool upload_waits::use(const LoadFuture& future)
 	{
-		std::future<void> f;
+		return use(is_ready(future), future.token.get());
+	}
+
+	bool upload_waits::use(bool ready, const LoadToken* token)
+	{
+		if(token && !token->owned)
+			return false;
+		if(ready)
+			return true;
+		std::optional<timeline_point> point = token ? token->timeline() : std::nullopt;
+		if(!point)
+			return false;
+		add(*point, vk::PipelineStageFlagBits::eAllCommands);
+		return true;
+	}
+
+	void resource_loader::acquire(vk::CommandBuffer cmd, upload_waits& waits)
+	{
+		std::vector<pending_acquire> ready;
 		{
-			std::scoped_lock<std::mutex> l(lock);
-			tasks.push(LoadTask{.type = LoadType::Texture, .src = func, .dst = image, .promise = std::promise<void>()});
-			f = tasks.back().promise.get_future();
+			std::scoped_lock<std::mutex> l(acquireLock);
+			// the release has to be submitted before the acquire, which a timeline wait or the finished task guarantees
+			auto it = std::stable_partition(acquires.begin(), acquires.end(), [](pending_acquire& a){
+				return !a.point && !a.token->done();
+			});
+			std::move(it, acquires.end(), std::back_inserter(ready));
+			acquires.erase(it, acquires.end());
+		}
+		if(ready.empty())
+			return;
+
+		std::vector<vk::ImageMemoryBarrier> images;
+		std::vector<vk::BufferMemoryBarrier> buffers;
+		for(pending_acquire& a : ready)
+		{
+			images.insert(images.end(), a.barriers.images.begin(), a.barriers.images.end());
+			buffers.insert(buffers.end(), a.barriers.buffers.begin(), a.barriers.buffers.end());
+			if(a.point)
+				waits.add(*a.point, vk::PipelineStageFlagBits::eAllCommands);
+		}
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eAllCommands, {}, {}, buffers, images);
+
+		for(pending_acquire& a : ready)
+		{
+			if(a.point)
+				a.token->recorded(*a.point);
+			a.token->owned = true;
 		}
-		cv.notify_one();
-		return f;
 	}
 
-	std::future<void> resource_loader::loadModel(model* model, std::string filename)
+	void upload_waits::add(timeline_point point, vk::PipelineStageFlags stage)
 	{
-		std::future<void> f;
+		// a later value on the same timeline covers earlier ones
+		for(size_t i=0; i<semaphores.size(); i++)
 		{
-			std::scoped_lock<std::mutex> l(lock);
-			tasks.push(LoadTask{.type = LoadType::Model, .src = filename, .dst = model, .promise = std::promise<void>()});
-			f = tasks.back().promise.get_future();
+			if(semaphores[i] == point.semaphore)
+			{
+				values[i] = std::max(values[i], point.value);
+				stages[i] |= stage;
+				return;
+			}
 		}
-		cv.notify_one();
-		return f;
+		semaphores.push_back(point.semaphore);
+		values.push_back(point.value);
+		stages.push_back(stage);
+	}
+
+	void upload_waits::append(std::vector<vk::Semaphore>& waitSemaphores, std::vector<uint64_t>& waitValues, std::vector<vk::PipelineStageFlags>& waitStages)
+	{
+		waitValues.resize(waitSemaphores.size(), 0);
+		waitSemaphores.insert(waitSemaphores.end(), semaphores.begin(), semaphores.end());
+		waitValues.insert(waitValues.end(), values.begin(), values.end());
+		waitStages.insert(waitStages.end(), stages.begin(), stages.end());
+		semaphores.clear();
+		values.clear();
+		stages.clear();
 	}
 
 	// Ugly hack to get PNG size BEFORE loading it, so we can create a vk::Image and a vk::ImageView in advance
@@ -89,181 +323,608 @@ namespace render
 		return vk::Extent2D{ihdr.width, ihdr.height};
 	}
 
-	void load_texture(
-		int index, LoadTask& task,
-		vk::Device device, vma::Allocator allocator, vma::Allocation allocation,
-		vk::CommandBuffer commandBuffer, spng_ctx* ctx, 
-		uint8_t* decodeBuffer, size_t stagingSize, vk::Buffer stagingBuffer)
+	// decoded textures are always RGBA8
+	constexpr vk::DeviceSize texelSize = 4;
+
+	std::string task_name(const LoadTask& task)
 	{
-		texture* tex = std::get<texture*>(task.dst);
 		if(std::holds_alternative<std::string>(task.src))
+			return std::get<std::string>(task.src);
+		if(task.type == LoadType::Buffer)
+			return "buffer upload";
+		if(task.type == LoadType::Image)
+			return "image upload";
+		return "dynamic resource";
+	}
+
+	std::vector<uint8_t> decode_png(const std::string& filename, std::span<const std::byte> file, vk::Extent2D& extent)
+	{
+		std::unique_ptr<spng_ctx, decltype(&spng_ctx_free)> ctx(spng_ctx_new(0), &spng_ctx_free);
+		spng_set_png_buffer(ctx.get(), file.data(), file.size());
+
+		struct spng_ihdr ihdr;
+		if(int err = spng_get_ihdr(ctx.get(), &ihdr))
+			throw std::runtime_error("cannot read PNG header of "+filename+": "+spng_strerror(err));
+		extent = vk::Extent2D(ihdr.width, ihdr.height);
+
+		// computed by spng in size_t and checked for overflow, width * height of a hostile header wraps in 32 bits
+		size_t size;
+		if(int err = spng_decoded_image_size(ctx.get(), SPNG_FMT_RGBA8, &size))
+			throw std::runtime_error("cannot decode "+filename+": "+spng_strerror(err));
+		std::vector<uint8_t> pixels(size);
+		if(int err = spng_decode_image(ctx.get(), pixels.data(), pixels.size(), SPNG_FMT_RGBA8, 0))
+			throw std::runtime_error("cannot decode "+filename+": "+spng_strerror(err));
+		return pixels;
+	}
+
+	bool is_srgb(vk::Format format)
+	{
+		return format == vk::Format::eR8G8B8A8Srgb || format == vk::Format::eB8G8R8A8Srgb;
+	}
+
+	// Fills the levels above 0 with a cascade of linear blits, afterwards all levels are in eShaderReadOnlyOptimal
+	void blit_mips(vk::CommandBuffer cmd, texture* tex)
+	{
+		auto level_size = [tex](uint32_t level){
+			return vk::Offset3D(std::max(tex->width >> level, 1), std::max(tex->height >> level, 1), 1);
+		};
+		for(uint32_t level=1; level<tex->mipLevels; level++)
 		{
-			std::ifstream in(std::get<std::string>(task.src), std::ios_base::ate | std::ios_base::binary);
-			size_t size = in.tellg();
-			std::vector<char> data(size);
-			in.seekg(0);
-			in.read(data.data(), size);
-
-			spng_set_png_buffer(ctx, data.data(), data.size());
-
-			struct spng_ihdr ihdr;
-    		spng_get_ihdr(ctx, &ihdr);
-			tex->create_image(ihdr.width, ihdr.height);
-
-			size_t decodedSize;
-			spng_decoded_image_size(ctx, SPNG_FMT_RGBA8, &decodedSize);
-			assert(decodedSize <= stagingSize);
-			spng_decode_image(ctx, decodeBuffer, decodedSize, SPNG_FMT_RGBA8, 0);
-		}
-		else
-		{
-			std::fill(decodeBuffer, decodeBuffer+stagingSize, 0x00);
-			std::get<LoaderFunction>(task.src)(decodeBuffer, stagingSize);
+			// the level before is complete now, so it becomes the source of this one
+			cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, 
+				vk::ImageMemoryBarrier(
+					vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferRead,
+					vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eTransferSrcOptimal, 
+					VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, 
+					tex->image, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, level-1, 1, 0, 1)));
+
+			vk::ImageBlit blit(
+				vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level-1, 0, 1), {vk::Offset3D(0, 0, 0), level_size(level-1)},
+				vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1), {vk::Offset3D(0, 0, 0), level_size(level)});
+			cmd.blitImage(tex->image, vk::ImageLayout::eTransferSrcOptimal, tex->image, vk::ImageLayout::eTransferDstOptimal,
+				blit, vk::Filter::eLinear);
 		}
-		void* buf = allocator.mapMemory(allocation);
-		std::copy(decodeBuffer, decodeBuffer+stagingSize, (char*)buf);
-		allocator.unmapMemory(allocation);
 
-		commandBuffer.begin(vk::CommandBufferBeginInfo());
-
-		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, 
+		std::array<vk::ImageMemoryBarrier, 2> barriers = {
 			vk::ImageMemoryBarrier(
-				{}, vk::AccessFlagBits::eTransferWrite,
-				vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, 
+				vk::AccessFlagBits::eTransferRead, {},
+				vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, 
 				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, 
-				tex->image, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)));
-		std::array<vk::BufferImageCopy, 1> copies = {
-			vk::BufferImageCopy(0, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), 
-				{}, {static_cast<uint32_t>(tex->width), static_cast<uint32_t>(tex->height), 1})
-		};
-		commandBuffer.copyBufferToImage(stagingBuffer, tex->image, vk::ImageLayout::eTransferDstOptimal, copies);
-		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, 
+				tex->image, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, tex->mipLevels-1, 0, 1)),
 			vk::ImageMemoryBarrier(
 				vk::AccessFlagBits::eTransferWrite, {},
 				vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, 
 				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, 
-				tex->image, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)));
-		commandBuffer.end();
+				tex->image, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, tex->mipLevels-1, 1, 0, 1))
+		};
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barriers);
+	}
+
+	void begin_upload(vk::CommandBuffer cmd, texture* tex)
+	{
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, 
+			vk::ImageMemoryBarrier(
+				{}, vk::AccessFlagBits::eTransferWrite,
+				vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, 
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, 
+				tex->image, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, tex->mipLevels, 0, 1)));
+	}
+
+	void end_upload(staging_stream& stream, texture* tex)
+	{
+		stream.release(tex->image, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, tex->mipLevels, 0, 1),
+			vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, vk::AccessFlagBits::eShaderRead);
+	}
+
+	void end_upload(staging_stream& stream, model* mesh)
+	{
+		stream.release(mesh->vertexBuffer, vk::AccessFlagBits::eVertexAttributeRead);
+		stream.release(mesh->indexBuffer, vk::AccessFlagBits::eIndexRead);
+	}
+
+	// Block compressed levels are uploaded as they are, there is nothing left to decode
+	RecordFunction upload_compressed(texture* tex, std::shared_ptr<cached_texture> compressed)
+	{
+		return [tex, compressed](staging_stream& stream){
+			begin_upload(stream.commandBuffer(), tex);
+			const ktx2_image& image = compressed->image();
+			for(uint32_t level=0; level<tex->mipLevels; level++)
+			{
+				vk::Extent2D extent(std::max(tex->width >> level, 1), std::max(tex->height >> level, 1));
+				stream.write_image(tex->image, level, extent, image.levels[level], 4);
+			}
+			end_upload(stream, tex);
+		};
+	}
 
+	// blitMips: the transfer queue can blit, otherwise mip levels are filtered on the CPU
+	// compress: PNGs are transcoded to BC formats and cached, which needs the textureCompressionBC feature
+	RecordFunction decode_texture(int index, LoadTask& task, task_timing& timing, vk::Device device, bool blitMips, bool compress,
+		vk::DeviceSize slotSize)
+	{
+		texture* tex = std::get<texture*>(task.dst);
+		std::vector<uint8_t> pixels;
 		if(std::holds_alternative<std::string>(task.src))
 		{
-			debugTag(device, tex->image, debug_tag::TextureSrc, std::get<std::string>(task.src));
-			debugName(device, tex->image, "Texture \""+std::get<std::string>(task.src)+"\"");
-			debugName(device, tex->imageView.get(), "Texture \""+std::get<std::string>(task.src)+"\" View");
+			const std::string& filename = std::get<std::string>(task.src);
+			std::shared_ptr<cached_texture> compressed;
+			if(filename.ends_with(".ktx2"))
+			{
+				if(!compress)
+					throw std::runtime_error("cannot load "+filename+", block compressed textures are disabled or not supported");
+				stage_timer t(timing, StageRead);
+				compressed = std::make_shared<cached_texture>(filename);
+				timing.bytes += compressed->size();
+			}
+			else
+			{
+				std::optional<stage_timer> read(std::in_place, timing, StageRead);
+				mapped_file file(filename, true);
+				timing.bytes += file.size();
+				std::span<const std::byte> source = std::as_bytes(std::span(file.data(), file.size()));
+				bool srgb = is_srgb(tex->format);
+				bool mips = tex->mipLevels != 1;
+				if(compress)
+				{
+					compressed = find_cached_texture(filename, source, srgb, mips);
+					if(compressed)
+						timing.bytes += compressed->size();
+				}
+				read.reset();
+				if(!compressed)
+				{
+					vk::Extent2D extent;
+					pixels = decode_png(filename, source, extent);
+					if(compress)
+					{
+						compressed = transcode_texture(filename, source, std::move(pixels), extent.width, extent.height, srgb, mips);
+						spdlog::info("[Resource Loader {}] Transcoded {} to {}", index, filename, vk::to_string(compressed->image().format));
+					}
+					else
+					{
+						tex->create_image(extent.width, extent.height);
+					}
+				}
+			}
+			if(compressed)
+			{
+				const ktx2_image& image = compressed->image();
+				tex->create_image(image.width, image.height, image.format, static_cast<uint32_t>(image.levels.size()));
+			}
+
+			debugTag(device, tex->image, debug_tag::TextureSrc, filename);
+			debugName(device, tex->image, "Texture \""+filename+"\"");
+			debugName(device, tex->imageView.get(), "Texture \""+filename+"\" View");
+			if(compressed)
+				return upload_compressed(tex, compressed);
 		}
-		else
+		uint32_t uploadLevels = blitMips ? 1 : tex->mipLevels;
+		if(std::holds_alternative<LoaderFunction>(task.src))
 		{
 			debugTag(device, tex->image, debug_tag::TextureSrc, "dynamic");
 			debugName(device, tex->image, "Dynamic Texture");
 			debugName(device, tex->imageView.get(), "Dynamic Texture View");
+
+			const LoaderFunction& loader = std::get<LoaderFunction>(task.src);
+			vk::DeviceSize rowSize = vk::DeviceSize(tex->width) * texelSize;
+			vk::DeviceSize size = rowSize * tex->height;
+			if(uploadLevels == 1 && size <= slotSize)
+			{
+				// the loader fills the staging memory directly once a submitter records it, only the bytes of this texture are cleared
+				return [tex, loader, rowSize, size](staging_stream& stream){
+					begin_upload(stream.commandBuffer(), tex);
+					uint8_t* dst = stream.reserve_rows(tex->image, 0, vk::Extent2D(tex->width, tex->height), 0, tex->height, rowSize);
+					std::memset(dst, 0, size);
+					loader(dst, size);
+
+					if(tex->mipLevels > 1)
+						blit_mips(stream.commandBuffer(), tex);
+					else
+						end_upload(stream, tex);
+				};
+			}
+			// mip levels filtered on the CPU or more than a slot
+			pixels.assign(size, 0x00);
+			loader(pixels.data(), pixels.size());
+		}
+		if(uploadLevels > 1)
+			generate_mips(pixels, tex->width, tex->height, uploadLevels, is_srgb(tex->format));
+
+		return [tex, uploadLevels, pixels = std::move(pixels)](staging_stream& stream){
+			begin_upload(stream.commandBuffer(), tex);
+
+			std::span<const std::byte> data = std::as_bytes(std::span(pixels));
+			for(uint32_t level=0; level<uploadLevels; level++)
+			{
+				vk::Extent2D extent(std::max(tex->width >> level, 1), std::max(tex->height >> level, 1));
+				vk::DeviceSize size = extent.width * extent.height * texelSize;
+				stream.write_image(tex->image, level, extent, data.subspan(0, size));
+				data = data.subspan(size);
+			}
+
+			// only blits on the graphics family, so there is no ownership to hand over
+			if(uploadLevels < tex->mipLevels)
+				blit_mips(stream.commandBuffer(), tex);
+			else
+				end_upload(stream, tex);
+		};
+	}
+
+	// Generated data is kept until it is recorded, spans belong to the caller
+	RecordFunction decode_upload(LoadTask& task, task_timing& timing)
+	{
+		std::shared_ptr<std::vector<std::byte>> generated;
+		std::span<const std::byte> data;
+		if(std::holds_alternative<LoaderFunction>(task.src))
+		{
+			generated = std::make_shared<std::vector<std::byte>>(task.size);
+			std::get<LoaderFunction>(task.src)(reinterpret_cast<uint8_t*>(generated->data()), generated->size());
+			data = *generated;
+		}
+		else
+		{
+			data = std::get<std::span<const std::byte>>(task.src);
+		}
+		timing.bytes += data.size();
+
+		if(task.type == LoadType::Buffer)
+		{
+			vk::Buffer buffer = std::get<vk::Buffer>(task.dst);
+			vk::DeviceSize offset = task.offset;
+			return [buffer, offset, data, generated](staging_stream& stream){
+				stream.write(buffer, offset, data);
+				stream.release(buffer, vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite, offset, data.size());
+			};
 		}
+
+		vk::Image image = std::get<vk::Image>(task.dst);
+		image_region region = task.region;
+		uint32_t rows = (region.extent.height + region.blockHeight - 1) / region.blockHeight;
+		if(rows == 0 || data.size() % rows != 0)
+			throw std::runtime_error("image upload of "+std::to_string(data.size())+" bytes does not consist of "+std::to_string(rows)+" rows");
+		return [image, region, data, generated](staging_stream& stream){
+			vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, region.mipLevel, 1, 0, 1);
+			stream.commandBuffer().pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, {}, {},
+				vk::ImageMemoryBarrier({}, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+					VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, range));
+			stream.write_image(image, region.mipLevel, region.extent, data, region.blockHeight);
+			stream.release(image, range, vk::ImageLayout::eTransferDstOptimal, region.layout, vk::AccessFlagBits::eMemoryRead);
+		};
 	}
 
-	void load_model(
-		int index, LoadTask& task,
-		vk::Device device, vma::Allocator allocator, vma::Allocation allocation,
-		vk::CommandBuffer commandBuffer, 
-		size_t stagingSize, vk::Buffer stagingBuffer)
+	// Imports straight into the staging memory, the whole mesh is never held on the CPU
+	void stream_model(int index, const std::string& filename, const obj_stream& source, model* mesh, staging_stream& stream)
 	{
-		std::ifstream obj(std::get<std::string>(task.src));
+		vk::DeviceSize vertexOffset = 0;
+		vk::DeviceSize indexOffset = 0;
+		size_t batches = 0;
+		source.emit([&](std::span<const vertex_data> vertices, std::span<const uint32_t> indices){
+			vk::DeviceSize vertexSize = vertices.size() * mesh->vertexStride();
+			uint8_t* vertexDst = stream.reserve(mesh->vertexBuffer, vertexOffset, vertexSize);
+			if(mesh->vertexFormat == vertex_format::Packed)
+				quantize_vertices(vertices, mesh->min, mesh->max, reinterpret_cast<packed_vertex_data*>(vertexDst));
+			else
+				std::memcpy(vertexDst, vertices.data(), vertexSize);
+			vertexOffset += vertexSize;
+
+			vk::DeviceSize indexSize = indices.size() * mesh->indexStride();
+			uint8_t* indexDst = stream.reserve(mesh->indexBuffer, indexOffset, indexSize);
+			if(mesh->indexType == vk::IndexType::eUint16)
+				std::copy(indices.begin(), indices.end(), reinterpret_cast<uint16_t*>(indexDst));
+			else
+				std::memcpy(indexDst, indices.data(), indexSize);
+			indexOffset += indexSize;
+			batches++;
+		});
+		spdlog::debug("[Resource Loader {}] Streamed {} in {} batches", index, filename, batches);
+	}
+
+	// CPU side result of a model, kept alive until it is recorded
+	struct model_data
+	{
+		std::unique_ptr<cached_mesh> cached;
 		std::vector<vertex_data> vertices;
+		std::vector<packed_vertex_data> packedVertices;
 		std::vector<uint32_t> indices;
-		load_obj(obj, vertices, indices);
 
+		// either points into the mapped cache file or into the arrays above
+		std::span<const std::byte> vertexData;
+		std::span<const std::byte> indexData;
+	};
+
+	// threads: for parsing and meshlets, the decoders already run on all cores
+	RecordFunction decode_model(int index, LoadTask& task, task_timing& timing, vk::Device device, unsigned int threads)
+	{
+		const std::string& filename = std::get<std::string>(task.src);
 		model* mesh = std::get<model*>(task.dst);
-		mesh->create_buffers(vertices.size(), indices.size());
-		for(auto& v : vertices)
+		const model_options& options = task.modelOptions;
+
+		mesh->vertexFormat = options.quantize ? vertex_format::Packed : vertex_format::Full;
+		auto name = [&]{
+			debugName(device, mesh->vertexBuffer, "Model \""+filename+"\" Vertex Buffer");
+			debugName(device, mesh->indexBuffer, "Model \""+filename+"\" Index Buffer");
+		};
+
+		auto data = std::make_shared<model_data>();
 		{
-			mesh->min = glm::min(mesh->min, v.position);
-			mesh->max = glm::max(mesh->max, v.position);
+			stage_timer t(timing, StageRead);
+			data->cached = find_cached_mesh(filename, options);
+			if(data->cached)
+				timing.bytes += data->cached->size();
 		}
+		bool wholeMesh = options.optimize || options.meshlets || options.lodCount > 0;
+		if(!data->cached && options.stream && wholeMesh)
+		{
+			spdlog::warn("[Resource Loader {}] Cannot stream {}, optimization, meshlets and LODs need the whole mesh", index, filename);
+		}
+		if(data->cached)
+		{
+			const mesh_cache_header& header = data->cached->header();
+			mesh->create_buffers(header.vertexCount, header.indexCount);
+			mesh->min = header.min;
+			mesh->max = header.max;
+			mesh->meshlets.assign(data->cached->meshlets().begin(), data->cached->meshlets().end());
+			mesh->lods.assign(data->cached->lods().begin(), data->cached->lods().end());
+
+			data->vertexData = data->cached->vertices();
+			data->indexData = data->cached->indices();
+		}
+		else if(options.stream && !wholeMesh)
+		{
+			// parsing happens while recording, which keeps a submitter busy but never holds the whole mesh
+			auto obj = std::make_shared<mapped_file>(filename);
+			timing.bytes += obj->size();
+			auto source = std::make_shared<obj_stream>(obj->view());
+
+			mesh->create_buffers(source->vertexCount(), source->indexCount());
+			mesh->min = source->min();
+			mesh->max = source->max();
+			mesh->lods = {model_lod{0, static_cast<uint32_t>(source->indexCount()), 0.0f}};
+			name();
+
+			return [index, filename, mesh, obj, source](staging_stream& stream){
+				stream_model(index, filename, *source, mesh, stream);
+				end_upload(stream, mesh);
+			};
+		}
+		else
+		{
+			std::vector<vertex_data>& vertices = data->vertices;
+			std::vector<uint32_t>& indices = data->indices;
 
-		vk::DeviceSize vertexOffset = 0;
-		vk::DeviceSize vertexSize = vertices.size() * sizeof(vertex_data);
-		vk::DeviceSize indexOffset = vertexSize;
-		vk::DeviceSize indexSize = indices.size() * sizeof(uint32_t);
+			std::optional<stage_timer> read(std::in_place, timing, StageRead);
+			mapped_file obj(filename, true);
+			timing.bytes += obj.size();
+			read.reset();
+			load_obj(obj.view(), vertices, indices, threads);
+
+			if(options.optimize)
+			{
+				float acmr = compute_acmr(indices, vertices.size());
+				std::vector<uint32_t> clusters = optimize_vertex_cache(indices, vertices.size());
+				optimize_overdraw(indices, vertices, clusters);
+				optimize_vertex_fetch(vertices, indices);
+				spdlog::info("[Resource Loader {}] Optimized {}: ACMR {:.3f} -> {:.3f}", index, filename,
+					acmr, compute_acmr(indices, vertices.size()));
+			}
+			if(options.meshlets)
+			{
+				mesh->meshlets = build_meshlets(indices, vertices, threads);
+			}
+			mesh->lods = generate_lods(indices, vertices, std::min(options.lodCount, model_options::maxLodCount), options.optimize);
+			if(mesh->lods.size() > 1)
+			{
+				spdlog::info("[Resource Loader {}] Generated {} LODs for {}, smallest has {} triangles", index,
+					mesh->lods.size()-1, filename, mesh->lods.back().indexCount/3);
+			}
 
-		void* buf = allocator.mapMemory(allocation);
-		std::copy(vertices.begin(), vertices.end(), (vertex_data*)((uint8_t*)buf+vertexOffset));
-		std::copy(indices.begin(), indices.end(), (uint32_t*)((uint8_t*)buf+indexOffset));
-		allocator.unmapMemory(allocation);
+			mesh->create_buffers(vertices.size(), indices.size());
+			for(auto& v : vertices)
+			{
+				mesh->min = glm::min(mesh->min, v.position);
+				mesh->max = glm::max(mesh->max, v.position);
+			}
+
+			if(options.quantize)
+			{
+				quantize_vertices(vertices, mesh->min, mesh->max, data->packedVertices);
+				data->vertexData = std::as_bytes(std::span(data->packedVertices));
+			}
+			else
+			{
+				data->vertexData = std::as_bytes(std::span(vertices));
+			}
+			if(mesh->indexType == vk::IndexType::eUint16)
+				data->indexData = narrow_indices(indices);
+			else
+				data->indexData = std::as_bytes(std::span(indices));
 
-		commandBuffer.begin(vk::CommandBufferBeginInfo());
-		vk::BufferCopy region(0, 0, 0);
-		commandBuffer.copyBuffer(stagingBuffer, mesh->vertexBuffer, region.setSrcOffset(vertexOffset).setSize(vertexSize));
-		commandBuffer.copyBuffer(stagingBuffer, mesh->indexBuffer, region.setSrcOffset(indexOffset).setSize(indexSize));
-		commandBuffer.end();
+			store_cached_mesh(filename, options, obj.view(), *mesh, data->vertexData, data->indexData);
+		}
+		name();
 
-		debugName(device, mesh->vertexBuffer, "Model \""+std::get<std::string>(task.src)+"\" Vertex Buffer");
-		debugName(device, mesh->indexBuffer, "Model \""+std::get<std::string>(task.src)+"\" Index Buffer");
+		return [mesh, data](staging_stream& stream){
+			stream.write(mesh->vertexBuffer, 0, data->vertexData);
+			stream.write(mesh->indexBuffer, 0, data->indexData);
+			end_upload(stream, mesh);
+		};
 	}
 
-	void resource_loader::loadThread(int index, vk::Queue queue)
+	void resource_loader::decodeThread(int index)
 	{
-		vk::UniqueCommandPool pool = device.createCommandPoolUnique(
-				vk::CommandPoolCreateInfo({}, transferFamily));
-		vk::UniqueCommandBuffer commandBuffer = std::move(device.allocateCommandBuffersUnique(
-				vk::CommandBufferAllocateInfo(pool.get(), vk::CommandBufferLevel::ePrimary, 1)).back());
-		vk::UniqueFence fence = device.createFenceUnique(vk::FenceCreateInfo());
+		spdlog::info("[Resource Loader {}]: Started", index);
+		std::unique_lock<std::mutex> l(lock);
+		while(true)
+		{
+			// decoded tasks hold their whole CPU side data, so stop decoding while the submitters are behind
+			cv.wait(l, [this]{
+				return quit || (tasks.size() && decoded.size() < maxDecoded);
+			});
+			if(quit)
+				break;
 
-		vk::BufferCreateInfo buffer_info({}, stagingSize, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive);
-		vma::AllocationCreateInfo alloc_info({}, vma::MemoryUsage::eCpuToGpu);
-		auto [stagingBuffer, allocation] = allocator.createBuffer(buffer_info, alloc_info);
+			DecodedTask d{.task = tasks.pop()};
+			loaderMetrics.waiting = tasks.size();
+			// a task may only use all cores while no other decoder is busy and none will be soon
+			unsigned int threads = busyDecoders == 0 && tasks.empty() ? std::max(std::thread::hardware_concurrency(), 1u) : 1;
+			busyDecoders++;
+			l.unlock();
 
-		uint8_t* cpuBuffer = new uint8_t[stagingSize];
+			if(!d.task.token->claim(LoadToken::Running))
+			{
+				spdlog::debug("[Resource Loader {}] Dropping cancelled {}", index, task_name(d.task));
+				abandon(d.task);
+				l.lock();
+				busyDecoders--;
+				continue;
+			}
 
-		spng_ctx *ctx = spng_ctx_new(0);
+			spdlog::debug("[Resource Loader {}] Loading {}", index, task_name(d.task));
+			auto t0 = std::chrono::steady_clock::now();
+			d.timing.stages[StageQueued] = t0 - d.task.queued;
+			try
+			{
+				if(d.task.type == Texture)
+				{
+					d.record = decode_texture(index, d.task, d.timing, device, transferFamily == graphicsFamily,
+						textureCompressionBC && config::CONFIG.compressTextures, stagingSize);
+				}
+				else if(d.task.type == Model)
+				{
+					d.record = decode_model(index, d.task, d.timing, device, threads);
+				}
+				else
+				{
+					d.record = decode_upload(d.task, d.timing);
+				}
+			}
+			catch(const std::exception& e)
+			{
+				spdlog::error("[Resource Loader {}] Failed to load {}: {}", index, task_name(d.task), e.what());
+				// nothing was recorded yet, so there is nothing to wait for
+				d.task.promise.set_exception(std::current_exception());
+				d.task.token->complete();
+				l.lock();
+				busyDecoders--;
+				continue;
+			}
+			auto t1 = std::chrono::steady_clock::now();
+			d.timing.stages[StageDecode] = (t1 - t0) - d.timing.stages[StageRead];
+			loaderMetrics.stages[StageRead].record(d.timing.stages[StageRead]);
+			loaderMetrics.stages[StageDecode].record(d.timing.stages[StageDecode]);
+			loaderMetrics.decoders[index].record(d.timing.bytes, t1 - t0);
+			spdlog::debug("[Resource Loader {}] Decoded {} in {} ms, {} ms of it reading", index, task_name(d.task),
+				std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count(),
+				std::chrono::duration_cast<std::chrono::milliseconds>(d.timing.stages[StageRead]).count());
+			d.decodedAt = t1;
+			if(d.task.type == Texture && std::holds_alternative<std::string>(d.task.src))
+			{
+				texture* tex = std::get<texture*>(d.task.dst);
+				d.task.token->discard = [tex]{ tex->destroy_image(); };
+			}
+			else if(d.task.type == Model)
+			{
+				model* mesh = std::get<model*>(d.task.dst);
+				d.task.token->discard = [mesh]{ mesh->destroy_buffers(); };
+			}
+			// can be cancelled again while it waits for a submitter
+			d.task.token->state = LoadToken::Waiting;
+
+			l.lock();
+			busyDecoders--;
+			LoadPriority priority = d.task.priority;
+			decoded.push(std::move(d), priority);
+			loaderMetrics.decoded = decoded.size();
+			decodedCv.notify_one();
+		}
+		spdlog::info("[Resource Loader {}]: Quit", index);
+	}
 
-		spdlog::info("[Resource Loader {}]: Started", index);
+	void resource_loader::submitThread(int index, vk::Queue queue)
+	{
+		staging_stream stream(device, allocator, queue, transferFamily, graphicsFamily, config::CONFIG.loaderStagingSlots, stagingSize,
+			config::CONFIG.loaderBatchSize, config::CONFIG.loaderBatchLatency, timelineSemaphore, &loaderMetrics, transferGranularity);
+
+		spdlog::info("[Resource Submitter {}]: Started", index);
 		std::unique_lock<std::mutex> l(lock);
 		do
 		{
-			cv.wait(l, [this]{
-				return (tasks.size() || quit);
+			if(decoded.empty() && stream.busy())
+			{
+				// tasks decoded shortly can still join the open batch
+				if(stream.batching() && decodedCv.wait_until(l, stream.deadline(), [this]{ return decoded.size() || quit; }))
+					continue;
+				// nothing left to record, so there is time to submit and wait for the transfers still in flight
+				l.unlock();
+				stream.drain();
+				l.lock();
+				continue;
+			}
+			decodedCv.wait(l, [this]{
+				return (decoded.size() || quit);
 			});
 
-			if(!quit && tasks.size())
+			if(!quit && decoded.size())
 			{
-				auto task = std::move(tasks.front());
-				tasks.pop();
+				auto d = decoded.pop();
+				loaderMetrics.decoded = decoded.size();
 				l.unlock();
+				cv.notify_one();
 
-				spdlog::debug("[Resource Loader {}] Loading {}", index,
-					std::holds_alternative<std::string>(task.src) ? std::get<std::string>(task.src) : "dynamic resource");
-				auto t0 = std::chrono::high_resolution_clock::now();
+				if(!d.task.token->claim(LoadToken::Running))
 				{
-					if(task.type == Texture)
-					{
-						load_texture(index, task, device, allocator, allocation, commandBuffer.get(), ctx, cpuBuffer, stagingSize, stagingBuffer);
-					}
-					else if(task.type == Model)
+					spdlog::debug("[Resource Submitter {}] Dropping cancelled {}", index, task_name(d.task));
+					abandon(d.task);
+					l.lock();
+					continue;
+				}
+
+				auto t0 = std::chrono::steady_clock::now();
+				d.timing.stages[StageQueued] += t0 - d.decodedAt;
+				loaderMetrics.stages[StageQueued].record(d.timing.stages[StageQueued]);
+
+				stream.poll();
+				try
+				{
+					uint64_t staged = stream.staged();
+					auto t1 = std::chrono::steady_clock::now();
+					d.record(stream);
+					auto t2 = std::chrono::steady_clock::now();
+					loaderMetrics.stages[StageStaging].record(t2 - t1);
+					loaderMetrics.submitters[index].record(stream.staged() - staged, t2 - t1);
+					timeline_point point{stream.semaphore(), stream.signalValue()};
+					if(queue_acquire barriers = stream.take_acquires(); !barriers.empty())
 					{
-						load_model(index, task, device, allocator, allocation, commandBuffer.get(), stagingSize, stagingBuffer);
+						// published by acquire() instead, nobody may use the resources before
+						d.task.token->owned = false;
+						std::scoped_lock<std::mutex> al(acquireLock);
+						acquires.push_back(pending_acquire{std::move(barriers), d.task.token,
+							timelineSemaphore ? std::optional(point) : std::nullopt, d.task.owner});
 					}
-					std::array<vk::SubmitInfo, 1> submits = {
-						vk::SubmitInfo({}, {}, commandBuffer.get(), {})
-					};
-					queue.submit(submits, fence.get());
-					vk::Result result = device.waitForFences(fence.get(), true, UINT64_MAX);
-					if(result != vk::Result::eSuccess)
+					else if(timelineSemaphore)
 					{
-						spdlog::error("[Resource Loader {}] Waiting for fence failed: {}", index, vk::to_string(result));
+						d.task.token->recorded(point);
 					}
-					device.resetCommandPool(pool.get());
-					device.resetFences(fence.get());
-					task.promise.set_value();
+
+					stream.submit(std::move(d.task.promise), nullptr, completion(d.task), d.task.queued);
+					// no point in waiting for more tasks to join the batch
+					if(d.task.priority == Critical)
+						stream.flush();
+				}
+				catch(const std::exception& e)
+				{
+					spdlog::error("[Resource Submitter {}] Failed to upload {}: {}", index, task_name(d.task), e.what());
+					stream.take_acquires();
+					// submitted anyway, the transfers recorded so far must finish before anyone can clean up
+					stream.submit(std::move(d.task.promise), std::current_exception(), completion(d.task), d.task.queued);
 				}
-				auto t1 = std::chrono::high_resolution_clock::now();
-				auto time = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
-				spdlog::debug("[Resource Loader {}] Loaded {} in {} ms", index,
-					std::holds_alternative<std::string>(task.src) ? std::get<std::string>(task.src) : "dynamic resource", time);
 
 				l.lock();
 			}
 		} while(!quit);
+		l.unlock();
 
-		spng_ctx_free(ctx);
-		allocator.destroyBuffer(stagingBuffer, allocation);
-		spdlog::info("[Resource Loader {}]: Quit", index);
+		stream.drain();
+		spdlog::info("[Resource Submitter {}]: Quit", index);
 	}
-}
\ No newline at end of file
+}
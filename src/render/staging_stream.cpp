@@ -0,0 +1,338 @@
+#include "render/staging_stream.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace render
+{
+	staging_stream::staging_stream(vk::Device device, vma::Allocator allocator, vk::Queue queue, uint32_t queueFamily, uint32_t ownerFamily,
+		unsigned int slotCount, vk::DeviceSize slotSize, unsigned int batchSize, std::chrono::milliseconds batchLatency,
+		bool timelineSemaphore, loader_metrics* metrics, vk::Extent3D granularity)
+		: device(device), allocator(allocator), queue(queue), queueFamily(queueFamily), ownerFamily(ownerFamily), granularity(granularity),
+		slotSize(slotSize), batchSize(std::max(batchSize, 1u)),
+		batchLatency(batchLatency), metrics(metrics), slots(std::max(slotCount, 1u))
+	{
+		if(timelineSemaphore)
+		{
+			vk::SemaphoreTypeCreateInfo type_info(vk::SemaphoreType::eTimeline, 0);
+			timeline = device.createSemaphoreUnique(vk::SemaphoreCreateInfo().setPNext(&type_info));
+		}
+		for(slot& s : slots)
+		{
+			s.pool = device.createCommandPoolUnique(vk::CommandPoolCreateInfo({}, queueFamily));
+			s.commandBuffer = std::move(device.allocateCommandBuffersUnique(
+				vk::CommandBufferAllocateInfo(s.pool.get(), vk::CommandBufferLevel::ePrimary, 1)).back());
+			s.fence = device.createFenceUnique(vk::FenceCreateInfo());
+
+			vk::BufferCreateInfo buffer_info({}, slotSize, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive);
+			// mapped for the whole lifetime of the stream, writers decode straight into it
+			vma::AllocationCreateInfo alloc_info(vma::AllocationCreateFlagBits::eMapped, vma::MemoryUsage::eCpuToGpu);
+			vma::AllocationInfo info;
+			auto [buffer, allocation] = allocator.createBuffer(buffer_info, alloc_info, &info);
+			s.buffer = buffer;
+			s.allocation = allocation;
+			s.memory = static_cast<uint8_t*>(info.pMappedData);
+		}
+	}
+
+	staging_stream::~staging_stream()
+	{
+		drain();
+		for(slot& s : slots)
+			allocator.destroyBuffer(s.buffer, s.allocation);
+	}
+
+	vk::DeviceSize staging_stream::allocate(vk::DeviceSize size, bool contiguous)
+	{
+		if(size > slotSize)
+			throw std::runtime_error("staging reservation larger than a staging slot");
+
+		vk::DeviceSize start = contiguous ? used : (used + 15) & ~vk::DeviceSize(15);
+		if(start + size > slotSize)
+		{
+			submit_slot();
+			start = 0;
+		}
+		begin();
+		used = start + size;
+		stagedBytes += size;
+		return start;
+	}
+
+	uint8_t* staging_stream::reserve(vk::Buffer dst, vk::DeviceSize offset, vk::DeviceSize size)
+	{
+		bool contiguous = pendingBuffer == dst && pending.size > 0 &&
+			pending.dstOffset + pending.size == offset && pending.srcOffset + pending.size == used;
+		vk::DeviceSize start = allocate(size, contiguous);
+
+		if(contiguous && start != 0)
+		{
+			pending.size += size;
+		}
+		else
+		{
+			record();
+			pendingBuffer = dst;
+			pending = vk::BufferCopy(start, offset, size);
+		}
+		return slots[current].memory + start;
+	}
+
+	void staging_stream::write(vk::Buffer dst, vk::DeviceSize offset, std::span<const std::byte> data)
+	{
+		while(!data.empty())
+		{
+			vk::DeviceSize size = std::min<vk::DeviceSize>(data.size(), slotSize);
+			std::memcpy(reserve(dst, offset, size), data.data(), size);
+			data = data.subspan(size);
+			offset += size;
+		}
+	}
+
+	uint8_t* staging_stream::reserve_rows(vk::Image dst, uint32_t mipLevel, vk::Extent2D extent, uint32_t y, uint32_t rows, vk::DeviceSize rowSize,
+		uint32_t blockHeight)
+	{
+		bool contiguous = false;
+		if(pendingImage == dst && !pendingRegions.empty())
+		{
+			const vk::BufferImageCopy& last = pendingRegions.back();
+			contiguous = last.imageSubresource.mipLevel == mipLevel && pendingRowSize == rowSize && pendingBlockHeight == blockHeight &&
+				last.imageOffset.y + pendingRows * blockHeight == y * blockHeight &&
+				last.bufferOffset + pendingRows * rowSize == used;
+		}
+		vk::DeviceSize start = allocate(rows * rowSize, contiguous);
+
+		// the last row of blocks can reach beyond the image
+		auto height = [&](uint32_t first, uint32_t count){
+			return std::min(count * blockHeight, extent.height - first * blockHeight);
+		};
+		if(contiguous && start != 0)
+		{
+			vk::BufferImageCopy& last = pendingRegions.back();
+			pendingRows += rows;
+			last.imageExtent.height = height(last.imageOffset.y / blockHeight, pendingRows);
+			return slots[current].memory + start;
+		}
+		if(pendingImage != dst || pendingRowSize != rowSize || pendingBlockHeight != blockHeight)
+		{
+			record();
+			pendingImage = dst;
+			pendingRowSize = rowSize;
+			pendingBlockHeight = blockHeight;
+		}
+		pendingRegions.push_back(vk::BufferImageCopy(start, 0, 0,
+			vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, mipLevel, 0, 1),
+			vk::Offset3D(0, static_cast<int32_t>(y * blockHeight), 0), vk::Extent3D(extent.width, height(y, rows), 1)));
+		pendingRows = rows;
+		return slots[current].memory + start;
+	}
+
+	void staging_stream::write_image(vk::Image dst, uint32_t mipLevel, vk::Extent2D extent, std::span<const std::byte> data, uint32_t blockHeight)
+	{
+		uint32_t rowCount = (extent.height + blockHeight - 1) / blockHeight;
+		vk::DeviceSize rowSize = data.size() / rowCount;
+		uint32_t rowsPerChunk = std::max<vk::DeviceSize>(slotSize / rowSize, 1);
+		// every chunk but the last has to start and end on the granularity. It counts texel blocks for compressed formats,
+		// so it is in rows either way. (0,0,0) allows whole mip levels only.
+		if(granularity.height == 0)
+		{
+			if(rowsPerChunk < rowCount)
+				throw std::runtime_error("mip level does not fit into a staging slot and the queue only copies whole mip levels");
+			rowsPerChunk = rowCount;
+		}
+		else if(rowsPerChunk < rowCount)
+		{
+			rowsPerChunk = std::max(rowsPerChunk / granularity.height, 1u) * granularity.height;
+		}
+		for(uint32_t y=0; y<rowCount; y+=rowsPerChunk)
+		{
+			uint32_t rows = std::min(rowsPerChunk, rowCount - y);
+			std::memcpy(reserve_rows(dst, mipLevel, extent, y, rows, rowSize, blockHeight), data.data() + y*rowSize, rows*rowSize);
+		}
+	}
+
+	vk::CommandBuffer staging_stream::commandBuffer()
+	{
+		begin();
+		record();
+		return slots[current].commandBuffer.get();
+	}
+
+	void staging_stream::release(vk::Image image, vk::ImageSubresourceRange range, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+		vk::AccessFlags dstAccess)
+	{
+		vk::CommandBuffer cmd = commandBuffer();
+		if(queueFamily == ownerFamily)
+		{
+			cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, {}, {},
+				vk::ImageMemoryBarrier(vk::AccessFlagBits::eTransferWrite, dstAccess, oldLayout, newLayout,
+					VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, range));
+			return;
+		}
+		// both halves have to agree on the layouts and families, access masks only count on their own side
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {},
+			vk::ImageMemoryBarrier(vk::AccessFlagBits::eTransferWrite, {}, oldLayout, newLayout, queueFamily, ownerFamily, image, range));
+		acquires.images.push_back(vk::ImageMemoryBarrier({}, dstAccess, oldLayout, newLayout, queueFamily, ownerFamily, image, range));
+	}
+
+	void staging_stream::release(vk::Buffer buffer, vk::AccessFlags dstAccess, vk::DeviceSize offset, vk::DeviceSize size)
+	{
+		// on the same family the semaphore or fence the user waits for makes the copies visible
+		if(queueFamily == ownerFamily)
+			return;
+		commandBuffer().pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {},
+			vk::BufferMemoryBarrier(vk::AccessFlagBits::eTransferWrite, {}, queueFamily, ownerFamily, buffer, offset, size), {});
+		acquires.buffers.push_back(vk::BufferMemoryBarrier({}, dstAccess, queueFamily, ownerFamily, buffer, offset, size));
+	}
+
+	queue_acquire staging_stream::take_acquires()
+	{
+		return std::exchange(acquires, queue_acquire());
+	}
+
+	void staging_stream::submit(std::promise<void> promise, std::exception_ptr error, std::shared_ptr<void> owner,
+		std::chrono::steady_clock::time_point queued)
+	{
+		auto now = std::chrono::steady_clock::now();
+		std::vector<completion>& completions = slots[current].completions;
+		if(completions.empty())
+			batchStart = now;
+		completions.push_back(completion{std::move(promise), error, std::move(owner), queued});
+		if(metrics)
+			metrics->inFlight++;
+		if(completions.size() >= batchSize || now >= deadline())
+			submit_slot();
+	}
+
+	void staging_stream::flush()
+	{
+		if(recording || batching())
+			submit_slot();
+	}
+
+	void staging_stream::poll()
+	{
+		for(size_t i=1; i<=slots.size(); i++)
+		{
+			slot& s = slots[(current+i) % slots.size()];
+			if(!s.inFlight)
+				continue;
+			if(device.getFenceStatus(s.fence.get()) != vk::Result::eSuccess)
+				break;
+			retire(s);
+		}
+		if(batching() && std::chrono::steady_clock::now() >= deadline())
+			submit_slot();
+	}
+
+	void staging_stream::drain()
+	{
+		flush();
+		// oldest first, a fence only covers its own submission
+		for(size_t i=1; i<=slots.size(); i++)
+		{
+			slot& s = slots[(current+i) % slots.size()];
+			if(s.inFlight)
+				retire(s);
+		}
+	}
+
+	bool staging_stream::busy() const
+	{
+		return batching() || std::any_of(slots.begin(), slots.end(), [](const slot& s){ return s.inFlight; });
+	}
+
+	bool staging_stream::batching() const
+	{
+		return !slots[current].completions.empty();
+	}
+
+	void staging_stream::begin()
+	{
+		if(recording)
+			return;
+		slots[current].commandBuffer->begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+		recording = true;
+	}
+
+	void staging_stream::record()
+	{
+		slot& s = slots[current];
+		if(pending.size > 0)
+			s.commandBuffer->copyBuffer(s.buffer, pendingBuffer, pending);
+		pendingBuffer = vk::Buffer();
+		pending = vk::BufferCopy();
+
+		if(!pendingRegions.empty())
+			s.commandBuffer->copyBufferToImage(s.buffer, pendingImage, vk::ImageLayout::eTransferDstOptimal, pendingRegions);
+		pendingImage = vk::Image();
+		pendingRegions.clear();
+		pendingRowSize = 0;
+		pendingRows = 0;
+		pendingBlockHeight = 1;
+	}
+
+	void staging_stream::submit_slot()
+	{
+		slot& s = slots[current];
+		begin();
+		record();
+		s.commandBuffer->end();
+		recording = false;
+
+		// staging memory is not necessarily host coherent
+		allocator.flushAllocation(s.allocation, 0, used);
+		vk::CommandBuffer cmd = s.commandBuffer.get();
+		vk::Semaphore semaphore = timeline.get();
+		uint64_t value = signalValue();
+		vk::TimelineSemaphoreSubmitInfo timeline_info({}, value);
+		std::array<vk::SubmitInfo, 1> submits = {
+			timeline ? vk::SubmitInfo({}, {}, cmd, semaphore, &timeline_info) : vk::SubmitInfo({}, {}, cmd, {})
+		};
+		queue.submit(submits, s.fence.get());
+		submissions++;
+		s.inFlight = true;
+		s.submitted = std::chrono::steady_clock::now();
+
+		current = (current+1) % slots.size();
+		used = 0;
+		if(slots[current].inFlight)
+			retire(slots[current]);
+	}
+
+	void staging_stream::retire(slot& s)
+	{
+		auto start = std::chrono::steady_clock::now();
+		vk::Result result = device.waitForFences(s.fence.get(), true, UINT64_MAX);
+		if(result != vk::Result::eSuccess)
+		{
+			spdlog::error("[Staging Stream] Waiting for fence failed: {}", vk::to_string(result));
+		}
+		auto end = std::chrono::steady_clock::now();
+		device.resetFences(s.fence.get());
+		device.resetCommandPool(s.pool.get());
+		s.inFlight = false;
+
+		for(completion& c : s.completions)
+		{
+			if(metrics)
+			{
+				metrics->stages[StageTransfer].record(end - s.submitted);
+				metrics->stages[StageFenceWait].record(end - start);
+				if(c.queued != std::chrono::steady_clock::time_point())
+					metrics->total.record(end - c.queued);
+				metrics->inFlight--;
+			}
+			if(c.error)
+				c.promise.set_exception(c.error);
+			else
+				c.promise.set_value();
+		}
+		s.completions.clear();
+	}
+}
@@ -1,14 +1,27 @@
 #include "render/texture.hpp"
 #include "render/debug.hpp"
 
+#include <algorithm>
+#include <bit>
+
 namespace render
 {
+	uint32_t texture::mip_count(int width, int height)
+	{
+		return std::bit_width(static_cast<uint32_t>(std::max(width, height)));
+	}
+
 	texture::texture(vk::Device device, vma::Allocator allocator, int width, int height,
-		vk::ImageUsageFlags usage, vk::Format format, vk::SampleCountFlagBits sampleCount, bool transfer, vk::ImageAspectFlags aspects) 
-		: device(device), allocator(allocator), width(width), height(height)
+		vk::ImageUsageFlags usage, vk::Format format, vk::SampleCountFlagBits sampleCount, bool transfer, vk::ImageAspectFlags aspects,
+		uint32_t mipLevels) 
+		: device(device), allocator(allocator), width(width), height(height), format(format),
+		mipLevels(mipLevels == fullMipChain ? mip_count(width, height) : mipLevels)
 	{
+		// higher levels are blitted from the ones below
+		if(this->mipLevels > 1)
+			usage |= vk::ImageUsageFlagBits::eTransferSrc;
 		vk::ImageCreateInfo image_info({}, vk::ImageType::e2D, format, 
-			{static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1}, 1, 1, 
+			{static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1}, this->mipLevels, 1, 
 			sampleCount, vk::ImageTiling::eOptimal,
 			usage | (transfer?vk::ImageUsageFlagBits::eTransferDst:vk::ImageUsageFlagBits{}), 
 			vk::SharingMode::eExclusive);
@@ -19,14 +32,17 @@ namespace render
 		allocation = a;
 
 		vk::ImageViewCreateInfo view_info({}, image, vk::ImageViewType::e2D, format, 
-			vk::ComponentMapping(), vk::ImageSubresourceRange(aspects, 0, 1, 0, 1));
+			vk::ComponentMapping(), vk::ImageSubresourceRange(aspects, 0, this->mipLevels, 0, 1));
 		imageView = device.createImageViewUnique(view_info);
 	}
 
 	texture::texture(vk::Device device, vma::Allocator allocator,
-		vk::ImageUsageFlags usage, vk::Format format, vk::SampleCountFlagBits sampleCount, bool transfer, vk::ImageAspectFlags aspects) 
-		: device(device), allocator(allocator)
+		vk::ImageUsageFlags usage, vk::Format format, vk::SampleCountFlagBits sampleCount, bool transfer, vk::ImageAspectFlags aspects,
+		uint32_t mipLevels) 
+		: device(device), allocator(allocator), format(format), mipLevels(mipLevels)
 	{
+		if(mipLevels != 1)
+			usage |= vk::ImageUsageFlagBits::eTransferSrc;
 		image_info = vk::ImageCreateInfo({}, vk::ImageType::e2D, format, 
 			{0, 0, 1}, 1, 1,
 			sampleCount, vk::ImageTiling::eOptimal,
@@ -37,22 +53,44 @@ namespace render
 	}
 
 	void texture::create_image(int width, int height)
+	{
+		create_image(width, height, format, UINT32_MAX);
+	}
+
+	void texture::create_image(int width, int height, vk::Format format, uint32_t availableMipLevels)
 	{
 		if(imageView)
 			return;
 
 		this->width = width;
 		this->height = height;
+		this->format = format;
+		if(mipLevels == fullMipChain)
+			mipLevels = mip_count(width, height);
+		mipLevels = std::min(mipLevels, availableMipLevels);
 		image_info.extent = vk::Extent3D{static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1};
+		image_info.mipLevels = mipLevels;
+		image_info.format = format;
+		view_info.format = format;
 
 		vma::AllocationCreateInfo alloc_info({}, vma::MemoryUsage::eGpuOnly);
 		auto [i, a] = allocator.createImage(image_info, alloc_info);
 		image = i;
 		allocation = a;
 
+		view_info.image = image;
+		view_info.subresourceRange.levelCount = mipLevels;
 		imageView = device.createImageViewUnique(view_info);
 	}
 
+	void texture::destroy_image()
+	{
+		imageView.reset();
+		allocator.destroyImage(image, allocation);
+		image = vk::Image();
+		allocation = vma::Allocation();
+	}
+
 	void texture::name(std::string name)
 	{
 		debugName(device, image, name+" Image");
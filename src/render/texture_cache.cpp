@@ -0,0 +1,158 @@
+#include "render/texture_cache.hpp"
+#include "render/bc_encoder.hpp"
+#include "render/mipmap.hpp"
+#include "config.hpp"
+#include "utils.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+namespace render
+{
+	namespace
+	{
+		// stored as the value of sourceKey, the cache is only valid for the same content and options
+		struct texture_source
+		{
+			uint64_t size;
+			uint64_t hash;
+			uint32_t flags;
+			uint32_t version;
+		};
+		constexpr std::string_view sourceKey = "vkplayground.source";
+		constexpr uint32_t currentVersion = 1;
+
+		texture_source make_source(std::span<const std::byte> source, bool srgb, bool mips)
+		{
+			return texture_source{
+				.size = source.size(),
+				.hash = utils::content_hash(source.data(), source.size()),
+				.flags = (srgb ? 1u : 0u) | (mips ? 2u : 0u),
+				.version = currentVersion
+			};
+		}
+
+		std::filesystem::path cache_path(const std::string& filename)
+		{
+			std::error_code ec;
+			std::filesystem::path source = std::filesystem::canonical(filename, ec);
+			if(ec)
+				source = filename;
+
+			const std::filesystem::path& directory = config::CONFIG.textureCacheDirectory;
+			if(directory.empty())
+				return source.string()+".ktx2";
+
+			std::string key = source.string();
+			return directory / fmt::format("{:016x}.ktx2", utils::content_hash(key.data(), key.size()));
+		}
+	}
+
+	cached_texture::cached_texture(const std::string& filename)
+		: file(std::make_unique<mapped_file>(filename, true)),
+		parsed(parse_ktx2(std::as_bytes(std::span(file->data(), file->size()))))
+	{
+	}
+
+	cached_texture::cached_texture(std::vector<std::byte> data)
+		: owned(std::move(data)), parsed(parse_ktx2(owned))
+	{
+	}
+
+	std::unique_ptr<cached_texture> find_cached_texture(const std::string& filename, std::span<const std::byte> source, bool srgb, bool mips)
+	{
+		std::filesystem::path path = cache_path(filename);
+		std::error_code ec;
+		if(!std::filesystem::exists(path, ec))
+			return nullptr;
+
+		std::unique_ptr<cached_texture> texture;
+		try
+		{
+			texture = std::make_unique<cached_texture>(path.string());
+		}
+		catch(const std::exception& e)
+		{
+			spdlog::warn("Cannot read texture cache {}: {}", path.string(), e.what());
+			return nullptr;
+		}
+
+		std::span<const std::byte> value = texture->image().value(sourceKey);
+		texture_source expected = make_source(source, srgb, mips);
+		if(value.size() != sizeof(texture_source) || std::memcmp(value.data(), &expected, sizeof(texture_source)) != 0)
+			return nullptr;
+		return texture;
+	}
+
+	std::unique_ptr<cached_texture> transcode_texture(const std::string& filename, std::span<const std::byte> source,
+		std::vector<uint8_t> pixels, uint32_t width, uint32_t height, bool srgb, bool mips)
+	{
+		bool opaque = true;
+		for(size_t i=3; i<pixels.size() && opaque; i+=4)
+			opaque = pixels[i] == 255;
+		size_t blockSize = opaque ? 8 : 16;
+		vk::Format format = opaque ?
+			(srgb ? vk::Format::eBc1RgbaSrgbBlock : vk::Format::eBc1RgbaUnormBlock) :
+			(srgb ? vk::Format::eBc3SrgbBlock : vk::Format::eBc3UnormBlock);
+
+		uint32_t mipLevels = mips ? std::bit_width(std::max(width, height)) : 1;
+		generate_mips(pixels, width, height, mipLevels, srgb);
+
+		std::vector<std::vector<std::byte>> blocks(mipLevels);
+		std::vector<std::span<const std::byte>> levels;
+		size_t offset = 0;
+		for(uint32_t level=0; level<mipLevels; level++)
+		{
+			uint32_t w = std::max(width >> level, 1u), h = std::max(height >> level, 1u);
+			blocks[level].resize(bc_size(w, h, blockSize));
+			uint8_t* out = reinterpret_cast<uint8_t*>(blocks[level].data());
+			if(opaque)
+				encode_bc1(pixels.data() + offset, w, h, out);
+			else
+				encode_bc3(pixels.data() + offset, w, h, out);
+			levels.push_back(blocks[level]);
+			offset += size_t(w) * h * 4;
+		}
+
+		texture_source info = make_source(source, srgb, mips);
+		std::vector<std::byte> data = write_ktx2(format, width, height, levels,
+			{{sourceKey, std::as_bytes(std::span(&info, 1))}});
+
+		// write to a temporary file first, so no loader ever maps a half-written cache
+		std::filesystem::path path = cache_path(filename);
+		std::error_code ec;
+		if(path.has_parent_path())
+			std::filesystem::create_directories(path.parent_path(), ec);
+		std::filesystem::path temp = path;
+		temp += fmt::format(".{:x}.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+		bool written;
+		{
+			std::ofstream out(temp, std::ios_base::binary | std::ios_base::trunc);
+			out.write(reinterpret_cast<const char*>(data.data()), data.size());
+			written = static_cast<bool>(out);
+		}
+		if(!written)
+		{
+			spdlog::warn("Failed to write texture cache {}", temp.string());
+			std::filesystem::remove(temp, ec);
+		}
+		else
+		{
+			std::filesystem::rename(temp, path, ec);
+			if(ec)
+			{
+				spdlog::warn("Failed to store texture cache {}: {}", path.string(), ec.message());
+				std::filesystem::remove(temp, ec);
+			}
+		}
+
+		return std::make_unique<cached_texture>(std::move(data));
+	}
+}
@@ -8,10 +8,12 @@
 
 #include <cxxabi.h>
 
+#include <algorithm>
 #include <iterator>
 #include <map>
 #include <set>
 #include <stdexcept>
+#include <string_view>
 
 using namespace config;
 
@@ -111,7 +113,7 @@ namespace render
 			.setApplicationVersion(constants::version)
 			.setPEngineName(constants::name.c_str())
 			.setEngineVersion(constants::version)
-			.setApplicationVersion(VK_VERSION_1_0);
+			.setApiVersion(VK_API_VERSION_1_2);
 		auto const inst_info = vk::InstanceCreateInfo()
 			.setPApplicationInfo(&app)
 			.setPEnabledLayerNames(layers)
@@ -187,15 +189,38 @@ namespace render
 			.setGeometryShader(true)
 			.setSampleRateShading(true)
 			.setFillModeNonSolid(true)
-			.setWideLines(true);
-		const std::vector<const char*> deviceExtensions = {
+			.setWideLines(true)
+			.setTextureCompressionBC(physicalDevice.getFeatures().textureCompressionBC);
+		// lets the GPU wait for uploads instead of the CPU, needs Vulkan 1.2
+		vk::PhysicalDeviceVulkan12Features features12;
+		if(deviceProperties.apiVersion >= VK_API_VERSION_1_2)
+		{
+			auto supported = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+			features12.setTimelineSemaphore(supported.get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore);
+		}
+		std::vector<const char*> deviceExtensions = {
     		VK_KHR_SWAPCHAIN_EXTENSION_NAME
 		};
+		// the instance asks for 1.2, so this is what VMA may use of it
+		uint32_t apiVersion = std::min<uint32_t>(VK_API_VERSION_1_2,
+			VK_MAKE_VERSION(VK_VERSION_MAJOR(deviceProperties.apiVersion), VK_VERSION_MINOR(deviceProperties.apiVersion), 0));
+		// real budgets for the residency manager instead of VMA's estimate,
+		// VMA queries them with vkGetPhysicalDeviceMemoryProperties2, which is core since 1.1
+		auto availableExtensions = physicalDevice.enumerateDeviceExtensionProperties();
+		bool memoryBudget = apiVersion >= VK_API_VERSION_1_1 &&
+			std::any_of(availableExtensions.begin(), availableExtensions.end(), [](const vk::ExtensionProperties& e){
+				return std::string_view(e.extensionName) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+			});
+		if(memoryBudget)
+			deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
 		vk::DeviceCreateInfo device_info = vk::DeviceCreateInfo()
 			.setQueueCreateInfos(queueInfos)
 			.setPEnabledFeatures(&features)
 			.setPEnabledLayerNames(layers)
 			.setPEnabledExtensionNames(deviceExtensions);
+		// 1.2 structures must not be chained for older devices, timeline semaphores stay disabled there
+		if(deviceProperties.apiVersion >= VK_API_VERSION_1_2)
+			device_info.setPNext(&features12);
 
 		device = physicalDevice.createDeviceUnique(device_info);
 		VULKAN_HPP_DEFAULT_DISPATCHER.init(device.get());
@@ -214,14 +239,19 @@ namespace render
 			transferQueues.push_back(graphicsQueue);
 		}
 
-		vma::AllocatorCreateInfo allocator_info({}, physicalDevice, device.get());
+		vma::AllocatorCreateInfo allocator_info(memoryBudget ? vma::AllocatorCreateFlagBits::eExtMemoryBudget : vma::AllocatorCreateFlags{},
+			physicalDevice, device.get());
 		allocator_info.setInstance(instance.get());
+		allocator_info.setVulkanApiVersion(apiVersion);
 		allocator = vma::createAllocator(allocator_info);
 
 		loader = std::make_unique<resource_loader>(device.get(), allocator, 
 			queueFamilyIndices.transferFamily.value_or(queueFamilyIndices.graphicsFamily.value()),
 			queueFamilyIndices.graphicsFamily.value(),
-			transferQueues);
+			transferQueues, features.textureCompressionBC, features12.timelineSemaphore,
+			families[queueFamilyIndices.transferFamily.value_or(queueFamilyIndices.graphicsFamily.value())].minImageTransferGranularity);
+		residency = std::make_unique<residency_manager>(allocator, physicalDevice.getMemoryProperties(), loader.get(),
+			device.get(), MAX_FRAMES_IN_FLIGHT);
 
 		auto formatIt = std::find_if(swapchainSupport.formats.begin(), swapchainSupport.formats.end(), [](auto f){
 			return f.format == vk::Format::eB8G8R8A8Srgb && f.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear;
@@ -336,7 +366,8 @@ namespace render
 		{
 			if(family.queueFlags & vk::QueueFlagBits::eGraphics)
 				indices.graphicsFamily = index;
-			else if(family.queueFlags & vk::QueueFlagBits::eTransfer)
+			// (0,0,0) would only allow whole mip levels, which do not fit into the loader's staging slots, use the graphics family then
+			else if((family.queueFlags & vk::QueueFlagBits::eTransfer) && family.minImageTransferGranularity.height > 0)
 				indices.transferFamily = index;
 			if(phyDev.getSurfaceSupportKHR(index, surface.get()))
 				indices.presentFamily = index;
@@ -367,6 +398,7 @@ namespace render
 		while(!glfwWindowShouldClose(win))
 		{
 			glfwPollEvents();
+			renderExecutor.run();
 
 			auto now = std::chrono::high_resolution_clock::now();
 			auto dt = std::chrono::duration<double>(now - lastFrame).count();
@@ -378,6 +410,7 @@ namespace render
 			r = device->waitForFences(inFlightFences[currentFrame], true, UINT64_MAX);
 			if(r != vk::Result::eSuccess)
 				spdlog::error("Waiting for inFlightFences[{}] failed with result {}", currentFrame, vk::to_string(r));
+			residency->next_frame();
 
 			auto [result, imageIndex] = device->acquireNextImageKHR(swapchain.get(), UINT64_MAX, imageAvailableSemaphores[currentFrame].get());
 			if(imagesInFlight[imageIndex])
@@ -424,6 +457,7 @@ namespace render
 	window::~window()
 	{
 		current_renderer.reset();
+		residency.reset();
 		loader.reset();
 
 		allocator.destroy();
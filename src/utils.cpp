@@ -1,5 +1,9 @@
 #include "utils.hpp"
 
+#include <array>
+#include <bit>
+#include <cstring>
+
 namespace utils
 {
 	std::string to_fixed_string(double d, int n)
@@ -8,4 +12,41 @@ namespace utils
 		oss << std::fixed << std::setprecision(n) << d;
 		return oss.str();
 	}
+
+	uint64_t content_hash(const void* data, size_t size)
+	{
+		constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+		constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+
+		const uint8_t* p = static_cast<const uint8_t*>(data);
+		auto read = [](const uint8_t* p) {
+			uint64_t v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		};
+		auto round = [](uint64_t acc, uint64_t v) {
+			return std::rotl(acc + v * prime2, 31) * prime1;
+		};
+
+		// four independent lanes so the multiplications can overlap
+		std::array<uint64_t, 4> lanes = {prime1 + prime2, prime2, 0, -prime1};
+		size_t i = 0;
+		for(; i + 32 <= size; i += 32)
+		{
+			for(int l=0; l<4; l++)
+				lanes[l] = round(lanes[l], read(p + i + l*8));
+		}
+
+		uint64_t h = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+		h += size;
+		for(; i + 8 <= size; i += 8)
+			h = round(h, read(p + i));
+		for(; i < size; i++)
+			h = std::rotl(h ^ (p[i] * prime1), 11) * prime2;
+
+		h ^= h >> 33;
+		h *= prime2;
+		h ^= h >> 29;
+		return h;
+	}
 }